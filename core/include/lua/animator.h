@@ -11,6 +11,8 @@ typedef struct Animation Animation;
 
 typedef struct Entity Entity;
 
+typedef struct SceneGraph SceneGraph;
+
 typedef struct Animator {
     Entity* entity;
     Animation* animation;
@@ -22,6 +24,9 @@ typedef struct Animator {
 
 int animator_create(lua_State* L);
 
+// Update kind of every animator, advances all of them before any Lua update runs
+void animator_update_batch(SceneGraph* graph, int first, int count);
+
 void register_animator_api(lua_State* L);
 
 #endif  // CORE_INCLUDE_LUA_ANIMATOR_H_
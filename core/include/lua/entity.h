@@ -40,10 +40,27 @@ int entity_set_position(lua_State* L);
 
 int entity_get_position(lua_State* L);
 
+int entity_set_rotation(lua_State* L);
+
+int entity_get_rotation(lua_State* L);
+
+int entity_set_scale(lua_State* L);
+
+int entity_get_scale(lua_State* L);
+
+int entity_set_layer(lua_State* L);
+
+int entity_get_layer(lua_State* L);
+
+int entity_set_parent(lua_State* L);
+
 void entity_parent_position(Entity* entity);
 
 void entity_call_update(SceneGraph* graph, GameObject* object);
 
+// Update kind of every entity with a Lua update function
+void entity_update_batch(SceneGraph* graph, int first, int count);
+
 void entity_call_load(lua_State* L, Entity* entity, int idx);
 
 void entity_setup_metatable(lua_State* L, Entity* entity, int idx);
@@ -5,6 +5,12 @@ typedef struct lua_State lua_State;
 
 typedef struct SpriteSheet SpriteSheet;
 
+typedef struct Transform2D Transform2D;
+
+typedef struct Drawable Drawable;
+
+typedef struct DrawSource DrawSource;
+
 typedef struct Sprite {
     int row;
     int col;
@@ -16,7 +22,16 @@ typedef struct Sprite {
     SpriteSheet* spritesheet;
 } Sprite;
 
-void sprite_draw(const Sprite* sprite, float x, float y);
+void sprite_draw(const Sprite* sprite, const Transform2D* transform);
+
+// Copies the texture and cell of the drawable's sprite entity, called when a frame is published
+void sprite_capture(const Drawable* drawable, DrawSource* source);
+
+// Draw kind of every sprite, one draw call per run of sprites on the same texture
+void sprite_draw_batch(const Drawable* drawables,
+                       const DrawSource* sources,
+                       const Transform2D* transforms,
+                       int count);
 
 Sprite* sprite_parse(lua_State* L, int node, int idx, Sprite* sprite);
 
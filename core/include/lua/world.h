@@ -7,12 +7,39 @@
 
 typedef struct SceneGraph SceneGraph;
 
+typedef struct SceneCommandBuffer SceneCommandBuffer;
+
+typedef struct ScenePresent ScenePresent;
+
 typedef struct lua_State lua_State;
 
+// Ticks per second a new world simulates at until World:set_tick_rate changes it
+#define WORLD_TICK_RATE 60
+
+// Update and draw kinds every world registers with its graph, in registration order
+enum {
+    WORLD_UPDATE_ANIMATOR = 1,
+    WORLD_UPDATE_SCRIPT,
+};
+
+enum {
+    WORLD_DRAW_SPRITE = 1,
+};
+
 typedef struct World {
     b2WorldId id;
     SceneGraph* graph;
+    SceneCommandBuffer* commands;
+    ScenePresent* present;
     lua_State* L;
+    float camera_x;
+    float camera_y;
+
+    // Fixed tick, real time not simulated yet, and the camera as of the last tick for interpolation
+    float time_step;
+    double accumulator;
+    float previous_camera_x;
+    float previous_camera_y;
 } World;
 
 extern World* worlds[256];
@@ -5,7 +5,11 @@
 #include <lua.h>
 #include <luajit.h>
 #include <lualib.h>
+#include <math.h>
+#include <pthread.h>
 #include <raylib.h>
+#include <rlgl.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -29,9 +33,13 @@
 #include "mpx/objectgroup.h"
 #include "mpx/tiledata.h"
 #include "mpx/tileset.h"
+#include "scene-graph/command-buffer.h"
 #include "scene-graph/parallel-graph-sort.h"
+#include "scene-graph/parallel-transform.h"
+#include "scene-graph/present.h"
 #include "scene-graph/scene-graph.h"
-#include "thpool/thpool.h"
+#include "thread-pool/task-graph.h"
+#include "thread-pool/thread-pool.h"
 #include "vec/vec.h"
 
 static int error_handler(lua_State* L) {
@@ -201,6 +209,205 @@ static void map_init(const char* file) {
     }
 }
 
+// Screen size the render thread last drew at, the simulation culls against it
+static atomic_int screen_width;
+static atomic_int screen_height;
+static atomic_bool running = true;
+
+// Ticks one frame may run to catch up, past that the backlog is dropped and the game slows down
+#define MAX_TICKS_PER_FRAME 5
+
+static double time_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Frame stages run on the job pool, transforms and ysort split their own work over it as well
+static ThreadPool* jobs;
+static TaskGraph* frame;
+
+// Nodes one tick may create through command buffers, acquiring past that returns NODE_NULL
+#define SIMULATION_NODE_BUDGET 1024
+
+// The render thread and the simulation thread, which only runs jobs while it waits on the frame.
+// Each one gets a physical core of its own, the workers take the cores after them.
+#define SIMULATION_RESERVED_THREADS 2
+#define SIMULATION_RENDER_CORE 0
+#define SIMULATION_CORE 1
+
+// WASTELAND_PIN=0 leaves every thread to the scheduler instead of one core each
+static bool threads_pinned(void) {
+    const char* pin = getenv("WASTELAND_PIN");
+    return pin == NULL || strcmp(pin, "0") != 0;
+}
+
+// One worker per physical core left over, more would only share a core with the reserved threads.
+// WASTELAND_WORKERS overrides the count.
+static ThreadPool* jobs_create(void) {
+    int workers       = thread_pool_core_count() - SIMULATION_RESERVED_THREADS;
+    const char* count = getenv("WASTELAND_WORKERS");
+    if (count != NULL) workers = atoi(count);
+    workers = workers > 0 ? workers : 0;
+
+    ThreadPool* pool = thread_pool_create(workers);
+    if (pool == NULL) {
+        fprintf(stderr, "Cannot start %d job workers\n", workers);
+        exit(EXIT_FAILURE);
+    }
+
+    int pinned = threads_pinned() ? thread_pool_pin(pool, SIMULATION_RESERVED_THREADS) : 0;
+    TraceLog(LOG_INFO,
+             "JOBS: Started %d workers (CPUs %d | Cores %d | Pinned %d)",
+             workers,
+             thread_pool_cpu_count(),
+             thread_pool_core_count(),
+             pinned);
+    return pool;
+}
+
+static void world_update(void* arg) {
+    World* world = arg;
+    scene_graph_tick_begin(world->graph);
+    world->previous_camera_x = world->camera_x;
+    world->previous_camera_y = world->camera_y;
+
+    scene_graph_update(world->graph);
+}
+
+static void world_step(void* arg) {
+    World* world = arg;
+    b2World_Step(world->id, world->time_step, 8);
+}
+
+static void world_sensor_events(void* arg) {
+    World* world = arg;
+    handle_collision_enter_events(world);
+    handle_collision_exit_events(world);
+}
+
+static void world_move_events(void* arg) {
+    handle_movement_events(arg);
+}
+
+static void world_transforms(void* arg) {
+    World* world = arg;
+    scene_command_buffers_flush(&world->commands, 1);
+    scene_graph_compute_positions_parallel(world->graph, jobs);
+
+    // Nobody records here, refill the slots the next tick's buffers may acquire
+    scene_graph_slots_reserve(world->graph, SIMULATION_NODE_BUDGET);
+}
+
+static void world_ysort(void* arg) {
+    World* world = arg;
+    scene_graph_ysort_parallel(world->graph, jobs);
+}
+
+static int frame_stage(const char* stage, int world, int tick, JobFunction function, World* arg) {
+    char name[TASK_GRAPH_NAME_LENGTH];
+    snprintf(name, sizeof(name), "w%d.%s#%d", world, stage, tick);
+    return task_graph_add(frame, name, function, arg);
+}
+
+// Queues the ticks of one world. Scripts share one Lua state, so everything calling into it is
+// ordered across worlds, while physics and transforms of different worlds overlap.
+static void frame_add_world(int index, int ticks) {
+    World* world = worlds[index];
+
+    for (int tick = 1; tick <= ticks; tick++) {
+        int update = frame_stage("update", index, tick, world_update, world);
+        task_graph_write(frame, update, world->graph);
+        task_graph_write(frame, update, world->L);
+        task_graph_write(frame, update, &world->id);
+        task_graph_write(frame, update, &world->camera_x);
+
+        int step = frame_stage("step", index, tick, world_step, world);
+        task_graph_write(frame, step, &world->id);
+
+        // Sensor handlers are scripts and may touch anything the update does
+        int sensors = frame_stage("sensors", index, tick, world_sensor_events, world);
+        task_graph_write(frame, sensors, world->graph);
+        task_graph_write(frame, sensors, world->L);
+        task_graph_write(frame, sensors, &world->id);
+        task_graph_write(frame, sensors, &world->camera_x);
+
+        int moves = frame_stage("moves", index, tick, world_move_events, world);
+        task_graph_read(frame, moves, &world->id);
+        task_graph_write(frame, moves, world->commands);
+
+        int transforms = frame_stage("transforms", index, tick, world_transforms, world);
+        task_graph_write(frame, transforms, world->graph);
+        task_graph_write(frame, transforms, world->commands);
+    }
+
+    if (ticks > 0) {
+        int ysort = frame_stage("ysort", index, ticks, world_ysort, world);
+        task_graph_write(frame, ysort, world->graph);
+    }
+}
+
+// Steps every world at its fixed tick rate and publishes it for drawing, overlapping the render of
+// the frame before. Frames between two ticks are drawn interpolated between them.
+static void* simulation_run(void* arg) {
+    (void)arg;
+    double last   = time_now();
+    bool schedule = getenv("WASTELAND_SCHEDULE") != NULL;
+
+    while (atomic_load(&running)) {
+        double now     = time_now();
+        double elapsed = now - last;
+        last           = now;
+
+        // Sprites are laid out on a 360 pixel tall virtual screen, cull against that view
+        float ratio = atomic_load(&screen_height) / 360.f;
+
+        task_graph_clear(frame);
+        for (int i = 0; i < worlds_count; i++) {
+            World* world = worlds[i];
+            world->accumulator += elapsed;
+
+            int ticks = (int)(world->accumulator / world->time_step);
+            ticks     = ticks < MAX_TICKS_PER_FRAME ? ticks : MAX_TICKS_PER_FRAME;
+            world->accumulator -= ticks * world->time_step;
+
+            // Past the clamp the backlog is dropped rather than caught up on, which would only grow it
+            world->accumulator = fmod(world->accumulator, world->time_step);
+            frame_add_world(i, ticks);
+        }
+
+        // The first frame that ticks anything shows the schedule, later frames only vary in ticks
+        if (schedule && frame->tasks_count > 0) {
+            task_graph_dump(frame, stdout);
+            schedule = false;
+        }
+
+        task_graph_run(frame);
+
+        for (int i = 0; i < worlds_count; i++) {
+            World* world = worlds[i];
+            float alpha  = world->accumulator / world->time_step;
+            scene_graph_alpha_set(world->graph, alpha);
+
+            Bounds view = {
+                .x      = world->previous_camera_x + (world->camera_x - world->previous_camera_x) * alpha,
+                .y      = world->previous_camera_y + (world->camera_y - world->previous_camera_y) * alpha,
+                .width  = atomic_load(&screen_width) / ratio,
+                .height = 360.f,
+            };
+
+            if (!scene_present_publish(world->present, world->graph, view)) {
+                return NULL;
+            }
+
+            // A journal covers the ticks between two published frames
+            scene_graph_journal_clear(world->graph);
+        }
+    }
+
+    return NULL;
+}
+
 int main(void) {
     InitWindow(1280, 720, "Witch");
     SetWindowState(FLAG_WINDOW_TOPMOST | FLAG_WINDOW_RESIZABLE);
@@ -214,36 +421,54 @@ int main(void) {
 
     for (int i = 0; i < worlds_count; i++) {
         scene_graph_compute_positions(worlds[i]->graph);
+        scene_graph_slots_reserve(worlds[i]->graph, SIMULATION_NODE_BUDGET);
     }
 
-    uint64_t count        = 0;
-    threadpool pool       = thpool_init(16);
-    const float time_step = 1.0f / 60.0f;
+    jobs  = jobs_create();
+    frame = task_graph_new(jobs);
+    atomic_store(&screen_width, GetScreenWidth());
+    atomic_store(&screen_height, GetScreenHeight());
+
+    // The window and GL context stay on this thread, the worlds are stepped on their own
+    pthread_t simulation;
+    pthread_create(&simulation, NULL, simulation_run, NULL);
+    if (threads_pinned()) {
+        thread_pool_pin_reserved(pthread_self(), SIMULATION_RENDER_CORE);
+        thread_pool_pin_reserved(simulation, SIMULATION_CORE);
+    }
 
     while (!WindowShouldClose()) {
-        for (int i = 0; i < worlds_count; i++) {
-            World* world = worlds[i];
-
-            scene_graph_update(world->graph);
-            b2World_Step(world->id, time_step, 8);
-            handle_collision_enter_events(world);
-            handle_collision_exit_events(world);
-            handle_movement_events(world);
-
-            scene_graph_compute_positions(world->graph);
-            scene_graph_ysort_parallel(world->graph, pool);
-        }
+        atomic_store(&screen_width, GetScreenWidth());
+        atomic_store(&screen_height, GetScreenHeight());
 
         BeginDrawing();
         ClearBackground(WHITE);
 
+        float ratio = GetScreenHeight() / 360.f;
         for (int i = 0; i < worlds_count; i++) {
-            scene_graph_render(worlds[i]->graph);
+            World* world              = worlds[i];
+            const PresentFrame* frame = scene_present_acquire(world->present);
+            if (frame == NULL) continue;
+
+            rlPushMatrix();
+            rlTranslatef(-frame->view.x * ratio, -frame->view.y * ratio, 0.0f);
+            scene_present_draw(frame);
+            rlPopMatrix();
+
+            scene_present_release(world->present);
         }
 
         DrawFPS(10, 10);
         EndDrawing();
     }
 
+    atomic_store(&running, false);
+    for (int i = 0; i < worlds_count; i++) {
+        scene_present_close(worlds[i]->present);
+    }
+
+    pthread_join(simulation, NULL);
+    task_graph_free(frame);
+    thread_pool_destroy(jobs);
     CloseWindow();
 }
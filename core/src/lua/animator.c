@@ -14,12 +14,11 @@
 #include "scene-graph/scene-graph.h"
 #include "spritesheet.h"
 
-static void animator_update(SceneGraph* graph, GameObject* object) {
-    Entity* entity = object->data;
+static void animator_advance(Entity* entity) {
     assert(entity->type == ENTITY_TYPE_ANIMATOR && "Entity type is wrong?");
 
     if (entity->animator.active) {
-        entity->animator.time += GetFrameTime() * entity->animator.time_multiplier;
+        entity->animator.time += entity->weak_world_ptr->time_step * entity->animator.time_multiplier;
         if (entity->animator.entity != NULL && entity->animator.animation != NULL) {
             Animator* animator   = &entity->animator;
             Sprite* sprite       = &animator->entity->sprite;
@@ -36,16 +35,25 @@ static void animator_update(SceneGraph* graph, GameObject* object) {
             }
         }
     }
+}
+
+void animator_update_batch(SceneGraph* graph, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        animator_advance(graph->game_objects[i].data);
+    }
 
-    if (entity->update_ref != LUA_NOREF) {
-        entity_call_update(graph, object);
+    // Lua may add game objects and grow the array, so go back through the graph every time
+    for (int i = first; i < first + count; i++) {
+        Entity* entity = graph->game_objects[i].data;
+        if (entity->update_ref != LUA_NOREF) {
+            entity_call_update(graph, &graph->game_objects[i]);
+        }
     }
 }
 
 static void animator_setup_update(lua_State* L, Entity* entity, int idx) {
     SceneGraph* graph  = entity->weak_world_ptr->graph;
-    GameObject* object = scene_graph_game_object_new(graph, entity->node);
-    object->update     = animator_update;
+    GameObject* object = scene_graph_game_object_new_kind(graph, entity->node, WORLD_UPDATE_ANIMATOR);
     object->data       = entity;
 
     lua_getfield(L, idx, "update");
@@ -69,10 +69,8 @@ int dynamic_body_move(lua_State* L) {
     return 0;
 }
 
-static void draw_sprite(SceneGraph* graph, Drawable* drawable) {
-    Sprite* sprite    = drawable->data;
-    Position position = scene_graph_position_get(graph, drawable->node);
-    sprite_draw(sprite, position.x, position.y);
+static void draw_sprite(const Drawable* drawable, const Transform2D* transform) {
+    sprite_draw(drawable->data, transform);
 }
 
 int dynamic_body_create(lua_State* L) {
@@ -48,6 +48,104 @@ int entity_get_position(lua_State* L) {
     return 2;
 }
 
+int entity_set_rotation(lua_State* L) {
+    assert(lua_gettop(L) == 2 && "Invalid arguments (entity, radians)");
+    assert(lua_isuserdata(L, 1) && "Invalid entity argument");
+    assert(lua_isnumber(L, 2) && "Invalid radians argument");
+
+    Entity* entity    = *(Entity**)lua_touserdata(L, 1);
+    SceneGraph* graph = entity->weak_world_ptr->graph;
+    float radians     = lua_tonumber(L, 2);
+
+    scene_graph_rotation_set(graph, entity->node, radians);
+    return 0;
+}
+
+int entity_get_rotation(lua_State* L) {
+    assert(lua_gettop(L) == 1 && "Invalid arguments (entity)");
+    assert(lua_isuserdata(L, 1) && "Invalid entity argument");
+
+    Entity* entity    = *(Entity**)lua_touserdata(L, 1);
+    SceneGraph* graph = entity->weak_world_ptr->graph;
+
+    lua_pushnumber(L, scene_graph_rotation_get(graph, entity->node));
+    return 1;
+}
+
+int entity_set_scale(lua_State* L) {
+    assert(lua_gettop(L) == 3 && "Invalid arguments (entity, x, y)");
+    assert(lua_isuserdata(L, 1) && "Invalid entity argument");
+    assert(lua_isnumber(L, 2) && "Invalid X argument");
+    assert(lua_isnumber(L, 3) && "Invalid Y argument");
+
+    Entity* entity    = *(Entity**)lua_touserdata(L, 1);
+    SceneGraph* graph = entity->weak_world_ptr->graph;
+    float x           = lua_tonumber(L, 2);
+    float y           = lua_tonumber(L, 3);
+
+    scene_graph_scale_set(graph, entity->node, (Scale){x, y});
+    return 0;
+}
+
+int entity_get_scale(lua_State* L) {
+    assert(lua_gettop(L) == 1 && "Invalid arguments (entity)");
+    assert(lua_isuserdata(L, 1) && "Invalid entity argument");
+
+    Entity* entity    = *(Entity**)lua_touserdata(L, 1);
+    SceneGraph* graph = entity->weak_world_ptr->graph;
+    Scale scale       = scene_graph_scale_get(graph, entity->node);
+
+    lua_pushnumber(L, scale.x);
+    lua_pushnumber(L, scale.y);
+    return 2;
+}
+
+int entity_set_layer(lua_State* L) {
+    assert(lua_gettop(L) == 2 && "Invalid arguments (entity, layer)");
+    assert(lua_isuserdata(L, 1) && "Invalid entity argument");
+    assert(lua_isnumber(L, 2) && "Invalid layer argument");
+
+    Entity* entity    = *(Entity**)lua_touserdata(L, 1);
+    SceneGraph* graph = entity->weak_world_ptr->graph;
+    int layer         = lua_tointeger(L, 2);
+    luaL_argcheck(L, layer >= 0 && layer < SCENE_GRAPH_LAYERS, 2, "layer out of range");
+
+    scene_graph_layer_set(graph, entity->node, layer);
+    return 0;
+}
+
+int entity_get_layer(lua_State* L) {
+    assert(lua_gettop(L) == 1 && "Invalid arguments (entity)");
+    assert(lua_isuserdata(L, 1) && "Invalid entity argument");
+
+    Entity* entity    = *(Entity**)lua_touserdata(L, 1);
+    SceneGraph* graph = entity->weak_world_ptr->graph;
+
+    lua_pushinteger(L, scene_graph_layer_get(graph, entity->node));
+    return 1;
+}
+
+int entity_set_parent(lua_State* L) {
+    assert(lua_gettop(L) == 2 && "Invalid arguments (entity, parent)");
+    assert(lua_isuserdata(L, 1) && "Invalid entity argument");
+
+    Entity* entity    = *(Entity**)lua_touserdata(L, 1);
+    SceneGraph* graph = entity->weak_world_ptr->graph;
+
+    // nil detaches the entity to the root where it stays in place on screen
+    if (lua_isnil(L, 2)) {
+        scene_graph_node_detach(graph, entity->node);
+        return 0;
+    }
+
+    assert(lua_isuserdata(L, 2) && "Invalid parent argument");
+    Entity* parent = *(Entity**)lua_touserdata(L, 2);
+    assert(parent->weak_world_ptr == entity->weak_world_ptr && "Parent must be in the same world");
+
+    scene_graph_node_reparent(graph, entity->node, parent->node);
+    return 0;
+}
+
 void entity_call_update(SceneGraph* graph, GameObject* object) {
     Entity* entity = object->data;
     lua_State* L   = entity->L;
@@ -69,6 +167,12 @@ void entity_call_update(SceneGraph* graph, GameObject* object) {
     }
 }
 
+void entity_update_batch(SceneGraph* graph, int first, int count) {
+    for (int i = first; i < first + count; i++) {
+        entity_call_update(graph, &graph->game_objects[i]);
+    }
+}
+
 int entity_get_parent_id(lua_State* L, int idx) {
     lua_getfield(L, idx, "parent");
     int parent_id = NODE_ROOT;
@@ -89,8 +193,7 @@ void entity_setup_update(lua_State* L, Entity* entity, int idx) {
     if (lua_isfunction(L, -1)) {
         SceneGraph* graph  = entity->weak_world_ptr->graph;
         entity->update_ref = luaL_ref(L, LUA_REGISTRYINDEX);
-        GameObject* object = scene_graph_game_object_new(graph, entity->node);
-        object->update     = entity_call_update;
+        GameObject* object = scene_graph_game_object_new_kind(graph, entity->node, WORLD_UPDATE_SCRIPT);
         object->data       = entity;
     } else {
         lua_pop(L, 1);
@@ -122,7 +225,9 @@ void entity_setup(lua_State* L, Entity* entity, int idx) {
     // Create node in scene graph
     int parent_id = entity_get_parent_id(L, 2);
     entity->node  = scene_graph_node_new(graph, parent_id);
-    assert(entity->node >= 0 && "Node cannot be INVALID");
+    if (entity->node == NODE_NULL) {
+        luaL_error(L, "Scene graph node limit reached");
+    }
 
     scene_graph_userdata_set(graph, entity->node, entity);
 }
@@ -166,6 +271,13 @@ int entity_create(lua_State* L) {
 static luaL_Reg entity_functions[] = {
     {"set_position", entity_set_position},
     {"get_position", entity_get_position},
+    {"set_rotation", entity_set_rotation},
+    {"get_rotation", entity_get_rotation},
+    {"set_scale", entity_set_scale},
+    {"get_scale", entity_get_scale},
+    {"set_layer", entity_set_layer},
+    {"get_layer", entity_get_layer},
+    {"set_parent", entity_set_parent},
     {NULL, NULL},
 };
 
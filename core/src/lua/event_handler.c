@@ -8,6 +8,7 @@
 #include "lua.h"
 #include "lua/entity.h"
 #include "lua/world.h"
+#include "scene-graph/command-buffer.h"
 #include "scene-graph/scene-graph.h"
 
 static int get_collision_enter_ref(Entity* entity) {
@@ -77,6 +78,7 @@ void handle_collision_exit_events(World* world) {
     }
 }
 
+// Only records into the world's command buffer, safe to run next to other worlds and systems
 void handle_movement_events(World* world) {
     b2BodyEvents events = b2World_GetBodyEvents(world->id);
     for (int j = 0; j < events.moveCount; j++) {
@@ -84,6 +86,6 @@ void handle_movement_events(World* world) {
         Entity* entity      = evt.userData;
         float x             = evt.transform.p.x;
         float y             = evt.transform.p.y;
-        scene_graph_position_set(world->graph, entity->node, (Position){x, y});
+        scene_command_position_set(world->commands, entity->node, (Position){x, y});
     }
 }
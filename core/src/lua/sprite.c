@@ -29,57 +29,93 @@ static int sprite_set_cell(lua_State* L) {
     return 0;
 }
 
-void sprite_draw(const Sprite* sprite, float x, float y) {
-    float ratio   = GetScreenHeight() / 360.f;
-    Rectangle src = {
-        .x      = sprite->col * sprite->step_x,
-        .y      = sprite->row * sprite->step_y,
-        .width  = sprite->step_x,
-        .height = sprite->step_y,
+static Vector2 sprite_corner(const Transform2D* transform, float x, float y, float ratio) {
+    return (Vector2){
+        .x = (transform->a * x + transform->c * y + transform->tx) * ratio,
+        .y = (transform->b * x + transform->d * y + transform->ty) * ratio,
     };
+}
+
+static void sprite_source(const Sprite* sprite, DrawSource* source) {
+    source->texture        = sprite->texture_id;
+    source->texture_width  = sprite->width;
+    source->texture_height = sprite->height;
+    source->source.x       = sprite->col * sprite->step_x;
+    source->source.y       = sprite->row * sprite->step_y;
+    source->source.width   = sprite->step_x;
+    source->source.height  = sprite->step_y;
+}
 
-    // Scale both position and dimensions
-    float scaled_x       = x * ratio;
-    float scaled_y       = y * ratio;
-    float scaled_width   = sprite->step_x * ratio;
-    float scaled_height  = sprite->step_y * ratio;
+// Emits the quad of a sprite's source, the texture has to be bound and RL_QUADS begun
+static void sprite_quad(const DrawSource* source, const Transform2D* transform, float ratio) {
+    const Bounds* src = &source->source;
 
-    float width          = sprite->width;
-    float height         = sprite->height;
-    Vector2 top_left     = (Vector2){scaled_x, scaled_y};
-    Vector2 top_right    = (Vector2){scaled_x + scaled_width, scaled_y};
-    Vector2 bottom_left  = (Vector2){scaled_x, scaled_y + scaled_height};
-    Vector2 bottom_right = (Vector2){scaled_x + scaled_width, scaled_y + scaled_height};
+    // Map the corners through the node's world transform, then scale to the screen
+    float width          = source->texture_width;
+    float height         = source->texture_height;
+    Vector2 top_left     = sprite_corner(transform, 0, 0, ratio);
+    Vector2 top_right    = sprite_corner(transform, src->width, 0, ratio);
+    Vector2 bottom_left  = sprite_corner(transform, 0, src->height, ratio);
+    Vector2 bottom_right = sprite_corner(transform, src->width, src->height, ratio);
 
-    rlSetTexture(sprite->texture_id);
-    rlBegin(RL_QUADS);
     rlColor4ub(255, 255, 255, 255);
     rlNormal3f(0.0f, 0.0f, 1.0f);
 
     // Top-left corner
-    rlTexCoord2f(src.x / width, src.y / height);
+    rlTexCoord2f(src->x / width, src->y / height);
     rlVertex2f(top_left.x, top_left.y);
 
     // Bottom-left corner
-    rlTexCoord2f(src.x / width, (src.y + src.height) / height);
+    rlTexCoord2f(src->x / width, (src->y + src->height) / height);
     rlVertex2f(bottom_left.x, bottom_left.y);
 
     // Bottom-right corner
-    rlTexCoord2f((src.x + src.width) / width, (src.y + src.height) / height);
+    rlTexCoord2f((src->x + src->width) / width, (src->y + src->height) / height);
     rlVertex2f(bottom_right.x, bottom_right.y);
 
     // Top-right corner
-    rlTexCoord2f((src.x + src.width) / width, src.y / height);
+    rlTexCoord2f((src->x + src->width) / width, src->y / height);
     rlVertex2f(top_right.x, top_right.y);
+}
+
+void sprite_draw(const Sprite* sprite, const Transform2D* transform) {
+    DrawSource source;
+    sprite_source(sprite, &source);
 
+    rlSetTexture(source.texture);
+    rlBegin(RL_QUADS);
+    sprite_quad(&source, transform, GetScreenHeight() / 360.f);
     rlEnd();
     rlSetTexture(0);
 }
 
-static void sprite_draw_ptr(SceneGraph* graph, Drawable* drawable) {
-    Entity* entity    = drawable->data;
-    Position position = scene_graph_position_get(graph, entity->node);
-    sprite_draw(&entity->sprite, position.x, position.y);
+void sprite_capture(const Drawable* drawable, DrawSource* source) {
+    const Entity* entity = drawable->data;
+    sprite_source(&entity->sprite, source);
+}
+
+void sprite_draw_batch(const Drawable* drawables,
+                       const DrawSource* sources,
+                       const Transform2D* transforms,
+                       int count) {
+    float ratio = GetScreenHeight() / 360.f;
+    int texture = -1;
+
+    // Sprites sharing a sheet stay inside one begin/end pair, a new one is only opened per texture.
+    // Only the captured sources are read, the entities keep animating while the frame is drawn.
+    for (int i = 0; i < count; i++) {
+        if (sources[i].texture != texture) {
+            if (texture != -1) rlEnd();
+            texture = sources[i].texture;
+            rlSetTexture(texture);
+            rlBegin(RL_QUADS);
+        }
+
+        sprite_quad(&sources[i], &transforms[i], ratio);
+    }
+
+    rlEnd();
+    rlSetTexture(0);
 }
 
 Sprite* sprite_parse(lua_State* L, int node, int idx, Sprite* sprite) {
@@ -127,6 +163,11 @@ int sprite_create(lua_State* L) {
     float y = lua_tonumber(L, -1);
     lua_pop(L, 1);
 
+    lua_getfield(L, 2, "layer");
+    int layer = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    luaL_argcheck(L, layer >= 0 && layer < SCENE_GRAPH_LAYERS, 2, "layer out of range");
+
     Entity* entity = malloc(sizeof(*entity));
     assert(entity != NULL && "Entity cannot be NULL");
 
@@ -139,18 +180,20 @@ int sprite_create(lua_State* L) {
     setup_metatable(L, "Sprite", 2, NULL, 0);
 
     sprite_parse(L, entity->node, 2, &entity->sprite);
-    Drawable* draw = scene_graph_drawable_new(world->graph, entity->node);
+    Drawable* draw = scene_graph_drawable_new_kind(world->graph, entity->node, WORLD_DRAW_SPRITE);
     Position p     = scene_graph_position_get(world->graph, entity->node);
     scene_graph_local_position_set(world->graph, entity->node, (Position){x, y});
 
     draw->data         = entity;
-    draw->draw         = sprite_draw_ptr;
     entity->type       = ENTITY_TYPE_SPRITE;
     entity->self_ref   = luaL_ref(L, LUA_REGISTRYINDEX);
     entity->sprite.col = col;
     entity->sprite.row = row;
 
+    Bounds bounds = {0, 0, entity->sprite.step_x, entity->sprite.step_y};
+    scene_graph_drawable_bounds_set(world->graph, entity->node, bounds);
     scene_graph_userdata_set(world->graph, entity->node, entity);
+    scene_graph_layer_set(world->graph, entity->node, layer);
 
     return 1;
 }
@@ -183,6 +226,13 @@ static luaL_Reg sprite_func_api[] = {
     {"set_cell", sprite_set_cell},
     {"set_position", entity_set_position},
     {"get_position", entity_get_position},
+    {"set_rotation", entity_set_rotation},
+    {"get_rotation", entity_get_rotation},
+    {"set_scale", entity_set_scale},
+    {"get_scale", entity_get_scale},
+    {"set_layer", entity_set_layer},
+    {"get_layer", entity_get_layer},
+    {"set_parent", entity_set_parent},
     {NULL, NULL},
 };
 
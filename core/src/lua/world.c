@@ -16,6 +16,8 @@
 #include "lua/entity.h"
 #include "lua/sprite.h"
 #include "lua/static_body.h"
+#include "scene-graph/command-buffer.h"
+#include "scene-graph/present.h"
 #include "scene-graph/scene-graph.h"
 
 World* worlds[256]  = {0};
@@ -32,11 +34,25 @@ static int create_world(lua_State* L) {
     b2WorldId id         = b2CreateWorld(&world_def);
     scene_graph_node_new(graph, NODE_NULL);
 
-    world->id              = id;
-    world->graph           = graph;
-    world->L               = L;
-    *world_ptr             = world;
-    worlds[worlds_count++] = world;
+    int animator = scene_graph_update_kind_register(graph, animator_update_batch);
+    int script   = scene_graph_update_kind_register(graph, entity_update_batch);
+    int sprite   = scene_graph_draw_kind_register(graph, sprite_draw_batch, sprite_capture);
+    assert(animator == WORLD_UPDATE_ANIMATOR && script == WORLD_UPDATE_SCRIPT && "Update kinds out of order");
+    assert(sprite == WORLD_DRAW_SPRITE && "Draw kinds out of order");
+
+    world->id                = id;
+    world->graph             = graph;
+    world->commands          = scene_command_buffer_new(graph);
+    world->present           = scene_present_new();
+    world->L                 = L;
+    world->camera_x          = 0.0f;
+    world->camera_y          = 0.0f;
+    world->time_step         = 1.0f / WORLD_TICK_RATE;
+    world->accumulator       = 0.0;
+    world->previous_camera_x = 0.0f;
+    world->previous_camera_y = 0.0f;
+    *world_ptr               = world;
+    worlds[worlds_count++]   = world;
 
     luaL_getmetatable(L, "World");
     lua_setmetatable(L, -2);
@@ -49,6 +65,32 @@ static int create_world(lua_State* L) {
     return 1;
 }
 
+static int world_set_camera(lua_State* L) {
+    World* world    = *(World**)lua_touserdata(L, 1);
+    world->camera_x = luaL_checknumber(L, 2);
+    world->camera_y = luaL_checknumber(L, 3);
+    return 0;
+}
+
+static int world_set_tick_rate(lua_State* L) {
+    World* world = *(World**)lua_touserdata(L, 1);
+    float rate   = luaL_checknumber(L, 2);
+    luaL_argcheck(L, rate > 0.0f, 2, "tick rate must be positive");
+
+    world->time_step = 1.0f / rate;
+    return 0;
+}
+
+static int world_set_layer(lua_State* L) {
+    World* world = *(World**)lua_touserdata(L, 1);
+    int layer    = luaL_checkinteger(L, 2);
+    luaL_argcheck(L, layer >= 0 && layer < SCENE_GRAPH_LAYERS, 2, "layer out of range");
+    luaL_checktype(L, 3, LUA_TBOOLEAN);
+
+    scene_graph_layer_ysort_set(world->graph, layer, lua_toboolean(L, 3));
+    return 0;
+}
+
 // Index/newindex handlers
 static int world_index(lua_State* L) {
     luaL_getmetatable(L, "World");
@@ -81,6 +123,9 @@ static luaL_Reg world_functions[] = {
     {"create_box_collider", box_collider_create},
     {"create_animator", animator_create},
     {"create_sprite", sprite_create},
+    {"set_camera", world_set_camera},
+    {"set_layer", world_set_layer},
+    {"set_tick_rate", world_set_tick_rate},
     {NULL, NULL},
 };
 
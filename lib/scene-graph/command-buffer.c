@@ -0,0 +1,172 @@
+#include "command-buffer.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+SceneCommandBuffer* scene_command_buffer_new(SceneGraph* graph) {
+    assert(graph != NULL && "Graph cannot be NULL");
+
+    SceneCommandBuffer* buffer = calloc(1, sizeof(SceneCommandBuffer));
+    assert(buffer != NULL && "Command buffer cannot be NULL");
+
+    buffer->graph = graph;
+    return buffer;
+}
+
+void scene_command_buffer_free(SceneCommandBuffer* buffer) {
+    if (buffer == NULL) return;
+
+    // Nodes recorded but never flushed give their slots back
+    for (int i = 0; i < buffer->commands_count; i++) {
+        if (buffer->commands[i].type == SCENE_COMMAND_CREATE) {
+            scene_graph_handle_free(buffer->graph, buffer->commands[i].node);
+        }
+    }
+
+    free(buffer->commands);
+    free(buffer);
+}
+
+static void scene_command_push(SceneCommandBuffer* buffer, SceneCommand command) {
+    // Each buffer belongs to a single thread, growing it needs no synchronisation
+    if (buffer->commands_count == buffer->commands_capacity) {
+        int capacity     = buffer->commands_capacity > 0 ? buffer->commands_capacity * 2 : 64;
+        buffer->commands = realloc(buffer->commands, sizeof(SceneCommand) * capacity);
+        assert(buffer->commands != NULL && "Failed to grow command buffer");
+        buffer->commands_capacity = capacity;
+    }
+
+    buffer->commands[buffer->commands_count++] = command;
+}
+
+Node scene_command_node_new(SceneCommandBuffer* buffer, Node parent) {
+    Node node = scene_graph_handle_acquire(buffer->graph);
+    if (node == NODE_NULL) return NODE_NULL;
+
+    scene_command_push(buffer, (SceneCommand){
+        .type   = SCENE_COMMAND_CREATE,
+        .node   = node,
+        .parent = parent,
+    });
+
+    return node;
+}
+
+void scene_command_node_destroy(SceneCommandBuffer* buffer, Node node) {
+    scene_command_push(buffer, (SceneCommand){
+        .type = SCENE_COMMAND_DESTROY,
+        .node = node,
+    });
+}
+
+void scene_command_node_reparent(SceneCommandBuffer* buffer, Node node, Node parent) {
+    scene_command_push(buffer, (SceneCommand){
+        .type   = SCENE_COMMAND_REPARENT,
+        .node   = node,
+        .parent = parent,
+    });
+}
+
+void scene_command_position_set(SceneCommandBuffer* buffer, Node node, Position position) {
+    scene_command_push(buffer, (SceneCommand){
+        .type     = SCENE_COMMAND_POSITION,
+        .node     = node,
+        .position = position,
+    });
+}
+
+void scene_command_local_position_set(SceneCommandBuffer* buffer, Node node, Position position) {
+    scene_command_push(buffer, (SceneCommand){
+        .type     = SCENE_COMMAND_LOCAL_POSITION,
+        .node     = node,
+        .position = position,
+    });
+}
+
+void scene_command_rotation_set(SceneCommandBuffer* buffer, Node node, float radians) {
+    scene_command_push(buffer, (SceneCommand){
+        .type     = SCENE_COMMAND_ROTATION,
+        .node     = node,
+        .rotation = radians,
+    });
+}
+
+void scene_command_scale_set(SceneCommandBuffer* buffer, Node node, Scale scale) {
+    scene_command_push(buffer, (SceneCommand){
+        .type  = SCENE_COMMAND_SCALE,
+        .node  = node,
+        .scale = scale,
+    });
+}
+
+void scene_command_layer_set(SceneCommandBuffer* buffer, Node node, int layer) {
+    scene_command_push(buffer, (SceneCommand){
+        .type  = SCENE_COMMAND_LAYER,
+        .node  = node,
+        .layer = layer,
+    });
+}
+
+static bool scene_command_parent_alive(SceneGraph* graph, Node parent) {
+    return parent != NODE_NULL && scene_graph_index_get(graph, parent) != NODE_NULL;
+}
+
+static void scene_command_apply(SceneGraph* graph, const SceneCommand* command) {
+    // Commands recorded against a node that was destroyed in the meantime are dropped, as are
+    // commands on the NODE_NULL a create hands out once the reserved slots ran out
+    if (command->type != SCENE_COMMAND_CREATE &&
+        (command->node == NODE_NULL || scene_graph_index_get(graph, command->node) == NODE_NULL)) {
+        return;
+    }
+
+    // So are creates and reparents under a parent that is gone, or not inserted yet because a
+    // later buffer creates it. A dropped create hands its slot back.
+    if (command->type == SCENE_COMMAND_CREATE && !scene_command_parent_alive(graph, command->parent)) {
+        scene_graph_handle_free(graph, command->node);
+        return;
+    }
+
+    if (command->type == SCENE_COMMAND_REPARENT && !scene_command_parent_alive(graph, command->parent)) {
+        return;
+    }
+
+    switch (command->type) {
+        case SCENE_COMMAND_CREATE:
+            scene_graph_node_insert(graph, command->node, command->parent);
+            break;
+        case SCENE_COMMAND_DESTROY:
+            scene_graph_node_destroy(graph, command->node);
+            break;
+        case SCENE_COMMAND_REPARENT:
+            scene_graph_node_reparent(graph, command->node, command->parent);
+            break;
+        case SCENE_COMMAND_POSITION:
+            scene_graph_position_set(graph, command->node, command->position);
+            break;
+        case SCENE_COMMAND_LOCAL_POSITION:
+            scene_graph_local_position_set(graph, command->node, command->position);
+            break;
+        case SCENE_COMMAND_ROTATION:
+            scene_graph_rotation_set(graph, command->node, command->rotation);
+            break;
+        case SCENE_COMMAND_SCALE:
+            scene_graph_scale_set(graph, command->node, command->scale);
+            break;
+        case SCENE_COMMAND_LAYER:
+            scene_graph_layer_set(graph, command->node, command->layer);
+            break;
+    }
+}
+
+void scene_command_buffers_flush(SceneCommandBuffer** buffers, int count) {
+    // Buffer order then recording order, so the result never depends on thread timing
+    for (int i = 0; i < count; i++) {
+        SceneCommandBuffer* buffer = buffers[i];
+        for (int j = 0; j < buffer->commands_count; j++) {
+            scene_command_apply(buffer->graph, &buffer->commands[j]);
+        }
+
+        buffer->commands_count = 0;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef LIB_SCENE_GRAPH_COMMAND_BUFFER_H_
+#define LIB_SCENE_GRAPH_COMMAND_BUFFER_H_
+
+#include "scene-graph/scene-graph.h"
+
+typedef enum SceneCommandType {
+    SCENE_COMMAND_CREATE,
+    SCENE_COMMAND_DESTROY,
+    SCENE_COMMAND_REPARENT,
+    SCENE_COMMAND_POSITION,
+    SCENE_COMMAND_LOCAL_POSITION,
+    SCENE_COMMAND_ROTATION,
+    SCENE_COMMAND_SCALE,
+    SCENE_COMMAND_LAYER,
+} SceneCommandType;
+
+typedef struct SceneCommand {
+    SceneCommandType type;
+    Node node;
+    union {
+        Node parent;
+        Position position;
+        Scale scale;
+        float rotation;
+        int layer;
+    };
+} SceneCommand;
+
+// Recorded by one thread at a time, applied to the graph at the next flush
+typedef struct SceneCommandBuffer {
+    SceneGraph* graph;
+    SceneCommand* commands;
+    int commands_count;
+    int commands_capacity;
+} SceneCommandBuffer;
+
+SceneCommandBuffer* scene_command_buffer_new(SceneGraph* graph);
+
+// Frees the buffer, slots of nodes it recorded but never flushed are handed back to the graph
+void scene_command_buffer_free(SceneCommandBuffer* buffer);
+
+/**
+ * Records a new node under parent. The handle is usable for further commands right away, but the
+ * node only exists in the graph after the flush. A parent created by another buffer has to come
+ * from a buffer that is flushed earlier, a create under a parent that is missing at the flush is
+ * dropped along with every command on the new node.
+ *
+ * @return The handle of the new node, or NODE_NULL when no slot was reserved up front
+ */
+Node scene_command_node_new(SceneCommandBuffer* buffer, Node parent);
+
+void scene_command_node_destroy(SceneCommandBuffer* buffer, Node node);
+
+void scene_command_node_reparent(SceneCommandBuffer* buffer, Node node, Node parent);
+
+void scene_command_position_set(SceneCommandBuffer* buffer, Node node, Position position);
+
+void scene_command_local_position_set(SceneCommandBuffer* buffer, Node node, Position position);
+
+void scene_command_rotation_set(SceneCommandBuffer* buffer, Node node, float radians);
+
+void scene_command_scale_set(SceneCommandBuffer* buffer, Node node, Scale scale);
+
+void scene_command_layer_set(SceneCommandBuffer* buffer, Node node, int layer);
+
+/**
+ * Applies the buffers to their graph one after another in array order, each in recording order,
+ * then empties them. Must run on the thread that owns the graph while no buffer is recording.
+ *
+ * @param buffers Buffers to apply, all recorded against the same graph
+ * @param count Number of buffers
+ */
+void scene_command_buffers_flush(SceneCommandBuffer** buffers, int count);
+
+#endif  // LIB_SCENE_GRAPH_COMMAND_BUFFER_H_
@@ -1,6 +1,8 @@
 #include "graph-sort.h"
 
+#include <assert.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "scene-graph.h"
@@ -12,69 +14,348 @@ typedef struct {
 
 SceneGraph* global_graph_context;
 
+// Siblings are ordered by layer first, then by world y, or by creation on a static layer
+static int ysort_key_compare(const SceneGraph* graph, int a, int b) {
+    const int la = graph->nodes[a].layer;
+    const int lb = graph->nodes[b].layer;
+    if (la != lb) {
+        return (la > lb) - (la < lb);
+    }
+
+    if (!graph->layer_ysort[la]) {
+        const uint32_t sa = graph->sequences[scene_graph_slot(graph->node_ids[a])];
+        const uint32_t sb = graph->sequences[scene_graph_slot(graph->node_ids[b])];
+        return (sa > sb) - (sa < sb);
+    }
+
+    const float ay = graph->world_positions[a].y;
+    const float by = graph->world_positions[b].y;
+    return (ay > by) - (ay < by);
+}
+
 static int compare_by_y(const void* a, const void* b) {
     const int* da     = (const void*)a;
     const int* db     = (const void*)b;
     SceneGraph* graph = (void*)global_graph_context;
 
-    const float ay    = graph->world_positions[graph->node_indices[*da]].y;
-    const float by    = graph->world_positions[graph->node_indices[*db]].y;
-
-    return (ay > by) - (ay < by);
+    return ysort_key_compare(graph, scene_graph_index_get(graph, *da), scene_graph_index_get(graph, *db));
 }
 
-static void scene_graph_children_ysort(SceneGraph* graph, Node node, SceneNode* nodes, int* count) {
-    nodes[(*count)++] = graph->nodes[graph->node_indices[node]];
+// Sorts the sibling list of every parent and keeps the links in sorted order, so the next sort can
+// start from this one. A parent is sorted on its own, the order of the walk does not matter.
+static void scene_graph_children_ysort(SceneGraph* graph) {
+    int* siblings        = graph->sort_values;
+    global_graph_context = graph;
+
+    for (int i = 0; i < graph->nodes_count; i++) {
+        if (graph->children_counts[i] == 0) continue;
+
+        int siblings_length = 0;
+        int sibling_id      = graph->nodes[i].first_child;
+        while (sibling_id != -1) {
+            siblings[siblings_length++] = sibling_id;
+            sibling_id                  = scene_graph_sibling_get(graph, sibling_id);
+        }
 
-    int siblings[MAX_NODES];
-    int siblings_length = 0;
-    int sibling_id      = graph->nodes[graph->node_indices[node]].first_child;
-    while (sibling_id != -1) {
-        siblings[siblings_length++] = sibling_id;
-        sibling_id                  = graph->nodes[graph->node_indices[sibling_id]].next_sibling;
+        mergesort(siblings, siblings_length, sizeof(int), compare_by_y);
+
+        for (int s = 0; s < siblings_length; s++) {
+            SceneNode* child    = scene_graph_node_get(graph, siblings[s]);
+            child->prev_sibling = s > 0 ? siblings[s - 1] : NODE_NULL;
+            child->next_sibling = s < siblings_length - 1 ? siblings[s + 1] : NODE_NULL;
+        }
+
+        graph->nodes[i].first_child = siblings[0];
+        graph->nodes[i].last_child  = siblings[siblings_length - 1];
     }
+}
 
-    global_graph_context = graph;
-    mergesort(siblings, siblings_length, sizeof(int), compare_by_y);
+// Walks the sorted links in preorder, which draws every parent before its children
+static void scene_graph_draw_order_build(SceneGraph* graph) {
+    const Node root = graph->node_ids[0];
+    Node node       = root;
+    int count       = 0;
+    while (true) {
+        const int slot           = scene_graph_slot(node);
+        graph->draw_order[count] = slot;
+        graph->draw_ranks[slot]  = count++;
+
+        Node child = scene_graph_first_child_get(graph, node);
+        if (child != NODE_NULL) {
+            node = child;
+            continue;
+        }
+
+        while (node != root && scene_graph_sibling_get(graph, node) == NODE_NULL) {
+            node = scene_graph_parent_get(graph, node);
+        }
 
-    for (int i = 0; i < siblings_length; i++) {
-        int id = siblings[i];
-        scene_graph_children_ysort(graph, id, nodes, count);
+        if (node == root) break;
+        node = scene_graph_sibling_get(graph, node);
     }
+
+    assert(count == graph->nodes_count && "Draw order lost a node");
 }
 
 void scene_graph_ysort(SceneGraph* graph) {
-    int node_count = 0;
-    SceneNode temp_nodes[MAX_NODES];
-    Position temp_world_positions[MAX_NODES];
-    Position temp_local_positions[MAX_NODES];
-    Drawable temp_drawables[MAX_NODES];
-    int temp_drawable_length = 0;
+    if (scene_graph_ysort_incremental(graph)) return;
 
-    scene_graph_children_ysort(graph, 0, temp_nodes, &node_count);
+    scene_graph_children_ysort(graph);
+    scene_graph_draw_order_build(graph);
+    scene_graph_ysort_settle(graph);
+}
 
-    for (int i = 0; i < node_count; i++) {
-        int old_node_idx                      = graph->node_indices[temp_nodes[i].id];
-        int old_draw_idx                      = graph->drawable_indices[temp_nodes[i].id];
+static int compare_movers(const void* a, const void* b) {
+    const SortMover* ma = a;
+    const SortMover* mb = b;
+    return (mb->rank > ma->rank) - (mb->rank < ma->rank);
+}
 
-        graph->nodes[i]                       = temp_nodes[i];
-        graph->node_indices[temp_nodes[i].id] = i;
+static int compare_spans(const void* a, const void* b) {
+    const SortSpan* sa = a;
+    const SortSpan* sb = b;
+    if (sa->parent != sb->parent) {
+        return (sa->parent > sb->parent) - (sa->parent < sb->parent);
+    }
+
+    return (sa->first > sb->first) - (sa->first < sb->first);
+}
+
+static int compare_spans_first(const void* a, const void* b) {
+    const SortSpan* sa = a;
+    const SortSpan* sb = b;
+    return (sa->first > sb->first) - (sa->first < sb->first);
+}
+
+static void sibling_unlink(SceneGraph* graph, SceneNode* parent, SceneNode* node) {
+    if (node->prev_sibling != NODE_NULL) {
+        scene_graph_node_get(graph, node->prev_sibling)->next_sibling = node->next_sibling;
+    } else {
+        parent->first_child = node->next_sibling;
+    }
+
+    if (node->next_sibling != NODE_NULL) {
+        scene_graph_node_get(graph, node->next_sibling)->prev_sibling = node->prev_sibling;
+    } else {
+        parent->last_child = node->prev_sibling;
+    }
+}
+
+static void sibling_insert_after(SceneGraph* graph, SceneNode* parent, Node handle, Node prev) {
+    SceneNode* node    = scene_graph_node_get(graph, handle);
+    Node next          = prev != NODE_NULL ? scene_graph_sibling_get(graph, prev) : parent->first_child;
+    node->prev_sibling = prev;
+    node->next_sibling = next;
+
+    if (prev != NODE_NULL) {
+        scene_graph_node_get(graph, prev)->next_sibling = handle;
+    } else {
+        parent->first_child = handle;
+    }
+
+    if (next != NODE_NULL) {
+        scene_graph_node_get(graph, next)->prev_sibling = handle;
+    } else {
+        parent->last_child = handle;
+    }
+}
+
+static inline int draw_rank_get(const SceneGraph* graph, Node node) {
+    return graph->draw_ranks[scene_graph_slot(node)];
+}
+
+static int draw_parent_rank(const SceneGraph* graph, int rank) {
+    int index = graph->node_indices[graph->draw_order[rank]];
+    return draw_rank_get(graph, graph->nodes[index].parent);
+}
+
+// In preorder the subtree at rank ends at the first node whose parent is drawn before it
+static int subtree_end(const SceneGraph* graph, int rank) {
+    int end = rank + 1;
+    while (end < graph->nodes_count && draw_parent_rank(graph, end) >= rank) {
+        end++;
+    }
+
+    return end;
+}
 
-        temp_local_positions[i]               = graph->local_positions[old_node_idx];
-        temp_world_positions[i]               = graph->world_positions[old_node_idx];
+// Lays out [first, end) of the draw order again in preorder of the new links, the range holds
+// whole child subtrees
+static void span_relayout(SceneGraph* graph, int parent_rank, int first, int end) {
+    const Node parent = graph->node_handles[graph->draw_order[parent_rank]];
 
-        if (old_draw_idx != -1) {
-            temp_drawables[temp_drawable_length++] = graph->drawables[old_draw_idx];
+    // The head of the span is the only child in it whose new predecessor lies outside of it
+    int children = 0;
+    Node node    = NODE_NULL;
+    for (int rank = first; rank < end; rank++) {
+        if (draw_parent_rank(graph, rank) != parent_rank) continue;
+
+        Node child = graph->node_handles[graph->draw_order[rank]];
+        Node prev  = scene_graph_prev_sibling_get(graph, child);
+        if (prev == NODE_NULL || draw_rank_get(graph, prev) < first) {
+            node = child;
+        }
+        children++;
+    }
+
+    // The radix sort scratch is free between sorts
+    int* order = graph->sort_values;
+    int count  = 0;
+    while (true) {
+        order[count++] = scene_graph_slot(node);
+
+        Node child = scene_graph_first_child_get(graph, node);
+        if (child != NODE_NULL) {
+            node = child;
+            continue;
+        }
+
+        // Climb back to the next sibling, stopping after the last child of the span
+        Node up = scene_graph_parent_get(graph, node);
+        while (up != parent && scene_graph_sibling_get(graph, node) == NODE_NULL) {
+            node = up;
+            up   = scene_graph_parent_get(graph, node);
+        }
+
+        if (up == parent && --children == 0) break;
+        node = scene_graph_sibling_get(graph, node);
+    }
+
+    assert(count == end - first && "Span does not hold whole subtrees");
+    for (int i = 0; i < count; i++) {
+        graph->draw_order[first + i] = order[i];
+        graph->draw_ranks[order[i]]  = first + i;
+    }
+}
+
+bool scene_graph_ysort_incremental(SceneGraph* graph) {
+    assert(graph != NULL && "Graph cannot be NULL");
+
+    // Spans are only whole subtrees while the draw order follows the links, and past a quarter of
+    // the nodes moving a full sort is cheaper than repairing
+    const int queued = graph->sort_queue_count;
+    if (!graph->preordered || queued > graph->nodes_count / 4) return false;
+
+    SortMover* movers = graph->sort_movers;
+    SortSpan* spans   = graph->sort_spans;
+
+    // Hints are the closest siblings in front that stay put, taken before any link changes
+    int movers_count = 0;
+    for (int q = 0; q < queued; q++) {
+        int slot  = graph->sort_queue[q];
+        int index = graph->node_indices[slot];
+        if (index == NODE_NULL || index == 0) continue;
+
+        Node hint = graph->nodes[index].prev_sibling;
+        while (hint != NODE_NULL && graph->sort_queued[scene_graph_slot(hint)]) {
+            hint = scene_graph_node_get(graph, hint)->prev_sibling;
+        }
+
+        movers[movers_count++] = (SortMover){
+            .node = graph->node_handles[slot],
+            .hint = hint,
+            .rank = graph->draw_ranks[slot],
+        };
+    }
+
+    // With every mover out of the lists, what is left is still sorted
+    for (int m = 0; m < movers_count; m++) {
+        SceneNode* node = scene_graph_node_get(graph, movers[m].node);
+        sibling_unlink(graph, scene_graph_node_get(graph, node->parent), node);
+    }
+
+    // Later movers go back first so movers with equal keys keep their previous order
+    qsort(movers, movers_count, sizeof(SortMover), compare_movers);
+
+    int spans_count = 0;
+    for (int m = 0; m < movers_count; m++) {
+        const int index   = scene_graph_index_get(graph, movers[m].node);
+        const int rank    = movers[m].rank;
+        SceneNode* node   = &graph->nodes[index];
+        SceneNode* parent = scene_graph_node_get(graph, node->parent);
+        SortSpan span     = {.parent = draw_rank_get(graph, node->parent), .first = rank, .end = rank};
+
+        // Insertion from the hint, every sibling passed on the way changes the draw order
+        Node prev = movers[m].hint;
+        while (prev != NODE_NULL && ysort_key_compare(graph, scene_graph_index_get(graph, prev), index) > 0) {
+            int passed = draw_rank_get(graph, prev);
+            span.first = passed < span.first ? passed : span.first;
+            span.end   = passed > span.end ? passed : span.end;
+            prev       = scene_graph_node_get(graph, prev)->prev_sibling;
+        }
+
+        // A node that did not move towards the front may have to move towards the back
+        const bool forward = prev == movers[m].hint;
+        Node next          = prev != NODE_NULL ? scene_graph_sibling_get(graph, prev) : parent->first_child;
+        while (forward && next != NODE_NULL && ysort_key_compare(graph, scene_graph_index_get(graph, next), index) < 0) {
+            int passed = draw_rank_get(graph, next);
+            span.first = passed < span.first ? passed : span.first;
+            span.end   = passed > span.end ? passed : span.end;
+            prev       = next;
+            next       = scene_graph_sibling_get(graph, next);
+        }
+
+        sibling_insert_after(graph, parent, movers[m].node, prev);
+        if (span.first != span.end) {
+            spans[spans_count++] = span;
+        }
+    }
+
+    // Spans run up to the end of the subtree of their last child, overlapping spans of the same
+    // parent are merged, the ones that do not overlap are laid out on their own
+    for (int s = 0; s < spans_count; s++) {
+        spans[s].end = subtree_end(graph, spans[s].end);
+    }
+
+    qsort(spans, spans_count, sizeof(SortSpan), compare_spans);
+
+    int merged = 0;
+    for (int s = 0; s < spans_count; s++) {
+        SortSpan* span = merged > 0 ? &spans[merged - 1] : NULL;
+        if (span != NULL && span->parent == spans[s].parent && spans[s].first < span->end) {
+            span->end = spans[s].end > span->end ? spans[s].end : span->end;
+        } else {
+            spans[merged++] = spans[s];
         }
     }
 
-    for (int i = 0; i < node_count; i++) {
-        graph->local_positions[i] = temp_local_positions[i];
-        graph->world_positions[i] = temp_world_positions[i];
+    // Ordered by start a span inside an earlier one belongs to a subtree that was laid out with it
+    qsort(spans, merged, sizeof(SortSpan), compare_spans_first);
+
+    int covered = 0;
+    for (int s = 0; s < merged; s++) {
+        if (spans[s].first < covered) continue;
+
+        span_relayout(graph, spans[s].parent, spans[s].first, spans[s].end);
+        covered = spans[s].end;
+    }
+
+    graph->render_list_dirty |= merged > 0;
+
+    for (int q = 0; q < queued; q++) {
+        int slot  = graph->sort_queue[q];
+        int index = graph->node_indices[slot];
+        if (index != NODE_NULL) {
+            graph->sort_y[slot] = graph->world_positions[index].y;
+        }
+
+        graph->sort_queued[slot] = 0;
+    }
+
+    graph->sort_queue_count = 0;
+    return true;
+}
+
+void scene_graph_ysort_settle(SceneGraph* graph) {
+    for (int q = 0; q < graph->sort_queue_count; q++) {
+        graph->sort_queued[graph->sort_queue[q]] = 0;
     }
 
-    for (int i = 0; i < temp_drawable_length; i++) {
-        graph->drawables[i]                             = temp_drawables[i];
-        graph->drawable_indices[temp_drawables[i].node] = i;
+    for (int i = 0; i < graph->nodes_count; i++) {
+        graph->sort_y[scene_graph_slot(graph->node_ids[i])] = graph->world_positions[i].y;
     }
+
+    graph->sort_queue_count  = 0;
+    graph->preordered        = true;
+    graph->render_list_dirty = true;
 }
@@ -1,8 +1,26 @@
 #ifndef LIB_SCENE_GRAPH_GRAPH_SORT_H_
 #define LIB_SCENE_GRAPH_GRAPH_SORT_H_
 
+#include <stdbool.h>
+
 typedef struct SceneGraph SceneGraph;
 
+// Sorts every sibling list by layer, then world y, and rebuilds draw_order from them. Node storage
+// is left where it is.
 void scene_graph_ysort(SceneGraph* graph);
 
+/**
+ * Repairs the previous order instead of sorting from scratch. Every queued node is reinserted
+ * among its siblings starting from where it was, and only the draw order spans whose order
+ * actually changed are laid out again, so the cost follows the number of movers and not the node
+ * count.
+ *
+ * @param graph Scene graph, with world positions computed for this frame
+ * @return false when a full sort is needed instead, the queue is left untouched
+ */
+bool scene_graph_ysort_incremental(SceneGraph* graph);
+
+// Records the current order as sorted after a full sort, see scene_graph_ysort_incremental
+void scene_graph_ysort_settle(SceneGraph* graph);
+
 #endif  // LIB_SCENE_GRAPH_GRAPH_SORT_H_
@@ -4,174 +4,336 @@
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "scene-graph/graph-sort.h"
 #include "scene-graph/scene-graph.h"
-#include "thpool/thpool.h"
+#include "thread-pool/parallel.h"
 
-typedef struct Arguments {
-    SceneGraph* graph;
-    SceneNode* nodes;
-    int nodes_count;
-} Arguments;
-
-typedef struct NodePos {
-    int node;
-    int layer;
-    float y;
-} NodePos;
+#define RADIX_BITS 8
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_PASSES (64 / RADIX_BITS)
 
-static int compare_by_y(const void* a, const void* b) {
-    const NodePos* v1 = a;
-    const NodePos* v2 = b;
-    const float ay    = v1->y;
-    const float by    = v2->y;
+// Below this many children an insertion sort is cheaper than counting
+#define RADIX_SMALL_LIST 32
 
-    if (v1->layer != v2->layer) {
-        return v1->layer - v2->layer;
+// Parents packed at the front of sort_parents, with where their children start among all of theirs
+typedef struct PackedSort {
+    SceneGraph* graph;
+    int packed;
+} PackedSort;
+
+// One radix pass over a list too large for one worker, every chunk counts and scatters its own keys
+typedef struct RadixPass {
+    const uint64_t* keys;
+    const int* values;
+    uint64_t* out_keys;
+    int* out_values;
+    int shift;
+    uint32_t counts[PARALLEL_MAX_CHUNKS][RADIX_BUCKETS];
+} RadixPass;
+
+// Layer in the high half and y in the low half, both mapped so unsigned order is sort order. Nodes
+// on a static layer take their creation sequence instead of y.
+static inline uint64_t ysort_key(const SceneGraph* graph, int index) {
+    const int layer = graph->nodes[index].layer;
+    uint32_t bits;
+    if (graph->layer_ysort[layer]) {
+        memcpy(&bits, &graph->world_positions[index].y, sizeof(bits));
+
+        // Negative floats order backwards as integers, flip all their bits and the sign of the rest
+        bits = bits == 0x80000000u ? 0 : bits;
+        bits ^= (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+    } else {
+        bits = graph->sequences[scene_graph_slot(graph->node_ids[index])];
     }
 
-    return (v1->y > v2->y) - (v1->y < v2->y);
+    return (uint64_t)((uint32_t)layer ^ 0x80000000u) << 32 | bits;
 }
 
-static void sort_children(SceneGraph* graph, Node node) {
-    int count = scene_graph_node_get(graph, node)->children_count;
+static void insertion_sort(uint64_t* keys, int* values, int count) {
+    for (int i = 1; i < count; i++) {
+        uint64_t key = keys[i];
+        int value    = values[i];
 
-    if (count > 0) {
-        NodePos* nodes = malloc(count * sizeof(NodePos));
-        assert(nodes != NULL);
+        int j = i;
+        for (; j > 0 && keys[j - 1] > key; j--) {
+            keys[j]   = keys[j - 1];
+            values[j] = values[j - 1];
+        }
 
-        int child = scene_graph_first_child_get(graph, node);
-        for (int i = 0; i < count; i++) {
-            nodes[i] = (NodePos){
-                .y     = scene_graph_position_get(graph, child).y,
-                .layer = scene_graph_layer_get(graph, child),
-                .node  = child,
-            };
+        keys[j]   = key;
+        values[j] = value;
+    }
+}
 
-            child = scene_graph_sibling_get(graph, child);
+// Stable LSD radix sort, returns whichever buffer ends up holding the sorted values
+static const int* radix_sort(uint64_t* keys, int* values, uint64_t* tmp_keys, int* tmp_values, int count) {
+    if (count < RADIX_SMALL_LIST) {
+        insertion_sort(keys, values, count);
+        return values;
+    }
+
+    uint32_t counts[RADIX_PASSES][RADIX_BUCKETS] = {0};
+    for (int i = 0; i < count; i++) {
+        for (int pass = 0; pass < RADIX_PASSES; pass++) {
+            counts[pass][(keys[i] >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
         }
+    }
 
-        mergesort(nodes, count, sizeof(NodePos), compare_by_y);
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        const int shift = pass * RADIX_BITS;
+        uint32_t* c     = counts[pass];
 
-        // Update links
-        for (int i = 0; i < count - 1; i++) {
-            scene_graph_sibling_set(graph, nodes[i].node, nodes[i + 1].node);
+        // A digit every key shares leaves the order as it is, usually the whole layer half
+        if (c[(keys[0] >> shift) & (RADIX_BUCKETS - 1)] == (uint32_t)count) continue;
+
+        uint32_t offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            uint32_t n = c[b];
+            c[b]       = offset;
+            offset += n;
         }
 
-        scene_graph_first_child_set(graph, node, nodes[0].node);
-        scene_graph_sibling_set(graph, nodes[count - 1].node, NODE_NULL);
+        for (int i = 0; i < count; i++) {
+            uint32_t o    = c[(keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+            tmp_keys[o]   = keys[i];
+            tmp_values[o] = values[i];
+        }
 
-        free(nodes);
+        uint64_t* swap_keys = keys;
+        int* swap_values    = values;
+        keys                = tmp_keys;
+        values              = tmp_values;
+        tmp_keys            = swap_keys;
+        tmp_values          = swap_values;
     }
+
+    return values;
 }
 
-static void scene_graph_populate_array(SceneGraph* graph,
-                                       Node first_node,
-                                       SceneNode* nodes,
-                                       int* node_count) {
-    int stack[100];
-    int stack_len = 0;
-    int node      = first_node;
-
-    while (node != NODE_NULL) {
-        int index    = *node_count;
-        nodes[index] = *scene_graph_node_get(graph, node);
-        (*node_count)++;
-
-        Node first_child = scene_graph_first_child_get(graph, node);
-
-        if (first_child != NODE_NULL) {
-            // add the node to the stack
-            stack[stack_len++] = node;
-            node               = first_child;
-        } else {
-            // No children, try to move to next sibling
-            node = scene_graph_sibling_get(graph, node);
+static void radix_count_chunk(void* context, int chunk, int begin, int end) {
+    RadixPass* pass  = context;
+    uint32_t* counts = pass->counts[chunk];
+    memset(counts, 0, sizeof(pass->counts[chunk]));
 
-            // If no sibling, backtrack up the stack until we find a node with an unvisited sibling
-            while (node == NODE_NULL && stack_len > 0) {
-                stack_len--;  // Pop the stack
-                node = scene_graph_sibling_get(graph, stack[stack_len]);
-            }
-        }
+    for (int i = begin; i < end; i++) {
+        counts[(pass->keys[i] >> pass->shift) & (RADIX_BUCKETS - 1)]++;
     }
 }
 
-static void scene_graph_parallel(void* arg) {
-    Arguments* arguments = arg;
-    SceneGraph* graph    = arguments->graph;
-    SceneNode* nodes     = arguments->nodes;
+static void radix_scatter_chunk(void* context, int chunk, int begin, int end) {
+    RadixPass* pass  = context;
+    uint32_t* counts = pass->counts[chunk];
 
-    for (int i = 0; i < arguments->nodes_count; i++) {
-        sort_children(graph, nodes[i].id);
+    for (int i = begin; i < end; i++) {
+        uint32_t o          = counts[(pass->keys[i] >> pass->shift) & (RADIX_BUCKETS - 1)]++;
+        pass->out_keys[o]   = pass->keys[i];
+        pass->out_values[o] = pass->values[i];
     }
 }
 
-void scene_graph_ysort_parallel(SceneGraph* graph, threadpool pool) {
-    assert(graph != NULL && "Graph cannot be NULL");
+// Same as radix_sort with every pass split over the workers, for a parent too big for one of them
+static const int* radix_sort_parallel(ThreadPool* pool,
+                                      uint64_t* keys,
+                                      int* values,
+                                      uint64_t* tmp_keys,
+                                      int* tmp_values,
+                                      int count) {
+    // Both halves of a pass are cut into the same chunks, the scatter reuses the counts
+    const int chunks = parallel_chunks(pool, count, SCENE_GRAPH_YSORT_GRAIN);
+    RadixPass pass;
+
+    for (int shift = 0; shift < 64; shift += RADIX_BITS) {
+        pass.keys       = keys;
+        pass.values     = values;
+        pass.out_keys   = tmp_keys;
+        pass.out_values = tmp_values;
+        pass.shift      = shift;
+        parallel_for(pool, 0, count, SCENE_GRAPH_YSORT_GRAIN, radix_count_chunk, &pass);
+
+        int digit      = (keys[0] >> shift) & (RADIX_BUCKETS - 1);
+        uint32_t total = 0;
+        for (int c = 0; c < chunks; c++) {
+            total += pass.counts[c][digit];
+        }
 
-    int thread_count = 8;
-    Arguments args[thread_count];
-    int nodes_per_thread = graph->nodes_count / thread_count;
-    int remaining_nodes  = graph->nodes_count % thread_count;
+        if (total == (uint32_t)count) continue;
 
-    for (int i = 0; i < thread_count; i++) {
-        int thread_nodes = nodes_per_thread;
-        if (i == thread_count - 1) {
-            thread_nodes += remaining_nodes;
+        // Digit-major, chunk-minor offsets keep equal digits in the order they came in
+        uint32_t offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            for (int c = 0; c < chunks; c++) {
+                uint32_t n        = pass.counts[c][b];
+                pass.counts[c][b] = offset;
+                offset += n;
+            }
         }
 
-        args[i] = (Arguments){
-            .nodes       = &graph->nodes[i * nodes_per_thread],
-            .nodes_count = thread_nodes,
-            .graph       = graph,
-        };
+        parallel_for(pool, 0, count, SCENE_GRAPH_YSORT_GRAIN, radix_scatter_chunk, &pass);
+
+        uint64_t* swap_keys = keys;
+        int* swap_values    = values;
+        keys                = tmp_keys;
+        values              = tmp_values;
+        tmp_keys            = swap_keys;
+        tmp_values          = swap_values;
+    }
+
+    return values;
+}
+
+// Every parent owns the scratch range at its offset, its children gathered there in storage order
+static void sort_children(SceneGraph* graph, int parent, ThreadPool* pool) {
+    SceneNode* node    = &graph->nodes[parent];
+    const int count    = graph->children_counts[parent];
+    const int offset   = graph->sort_offsets[parent];
+    uint64_t* keys     = &graph->sort_keys[offset];
+    int* values        = &graph->sort_values[offset];
+    uint64_t* tmp_keys = &graph->sort_keys[graph->capacity + offset];
+    int* tmp_values    = &graph->sort_values[graph->capacity + offset];
+
+    for (int i = 0; i < count; i++) {
+        keys[i] = ysort_key(graph, values[i]);
+    }
 
-        thpool_add_work(pool, scene_graph_parallel, &args[i]);
+    const int* sorted = pool != NULL ? radix_sort_parallel(pool, keys, values, tmp_keys, tmp_values, count)
+                                     : radix_sort(keys, values, tmp_keys, tmp_values, count);
+    if (sorted != values) {
+        memcpy(values, sorted, sizeof(int) * count);
     }
 
-    // Now collect into temp arrays
-    SceneNode* temp_nodes          = malloc(sizeof(SceneNode) * MAX_NODES);
-    Position* temp_world_positions = malloc(sizeof(Position) * MAX_NODES);
-    Position* temp_local_positions = malloc(sizeof(Position) * MAX_NODES);
-    Drawable* temp_drawables       = malloc(sizeof(Drawable) * MAX_NODES);
-    int temp_node_count            = 0;
-    int temp_drawable_count        = 0;
+    // Update links
+    for (int i = 0; i < count; i++) {
+        SceneNode* child    = &graph->nodes[values[i]];
+        child->prev_sibling = i > 0 ? graph->node_ids[values[i - 1]] : NODE_NULL;
+        child->next_sibling = i < count - 1 ? graph->node_ids[values[i + 1]] : NODE_NULL;
+    }
 
-    thpool_wait(pool);
+    node->first_child = graph->node_ids[values[0]];
+    node->last_child  = graph->node_ids[values[count - 1]];
+}
 
-    scene_graph_populate_array(graph, graph->nodes[0].id, temp_nodes, &temp_node_count);
+// Chunks are ranges of children, a packed parent belongs to the chunk its first child falls in
+static void sort_packed_chunk(void* context, int chunk, int begin, int end) {
+    (void)chunk;
+
+    PackedSort* sort  = context;
+    SceneGraph* graph = sort->graph;
+    const int* starts = graph->sort_positions;
+    const int packed  = sort->packed;
+
+    int low  = 0;
+    int high = packed;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (starts[middle] < begin) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
 
-    for (int i = 0; i < temp_node_count; i++) {
-        int old_node_idx = scene_graph_index_get(graph, temp_nodes[i].id);
-        int old_draw_idx = graph->drawable_indices[temp_nodes[i].id];
+    for (int p = low; p < packed && starts[p] < end; p++) {
+        sort_children(graph, graph->sort_parents[p], NULL);
+    }
+}
+
+// Buckets every child under its parent in one pass over storage, reading nothing but storage order
+static void gather_children(SceneGraph* graph) {
+    int* offsets = graph->sort_offsets;
+    int* cursors = graph->sort_positions;
+
+    int offset = 0;
+    for (int i = 0; i < graph->nodes_count; i++) {
+        offsets[i] = offset;
+        cursors[i] = offset;
+        offset += graph->children_counts[i];
+    }
 
-        graph->nodes[i]  = temp_nodes[i];
-        scene_graph_index_set(graph, temp_nodes[i].id, i);
+    for (int i = 1; i < graph->nodes_count; i++) {
+        graph->sort_values[cursors[graph->parent_indices[i]]++] = i;
+    }
+}
 
-        temp_local_positions[i] = graph->local_positions[old_node_idx];
-        temp_world_positions[i] = graph->world_positions[old_node_idx];
+// Draw order rank of every node from subtree sizes, children placed in their sorted order
+static void build_order(SceneGraph* graph) {
+    const int count = graph->nodes_count;
+    int* positions  = graph->sort_positions;
 
-        if (old_draw_idx != NODE_NULL) {
-            temp_drawables[temp_drawable_count++] = graph->drawables[old_draw_idx];
+    // Children are stored after their parents, a backwards pass adds every subtree into its parent
+    for (int i = 0; i < count; i++) {
+        positions[i] = 1;
+    }
+
+    for (int i = count - 1; i > 0; i--) {
+        positions[graph->parent_indices[i]] += positions[i];
+    }
+
+    // Forwards a parent has its position before its children, which follow it size after size
+    positions[0] = 0;
+    for (int i = 0; i < count; i++) {
+        const int* children = &graph->sort_values[graph->sort_offsets[i]];
+        int next            = positions[i] + 1;
+        for (int c = 0; c < graph->children_counts[i]; c++) {
+            int size                = positions[children[c]];
+            positions[children[c]]  = next;
+            next                   += size;
         }
     }
 
-    for (int i = 0; i < temp_node_count; i++) {
-        graph->local_positions[i] = temp_local_positions[i];
-        graph->world_positions[i] = temp_world_positions[i];
+    for (int i = 0; i < count; i++) {
+        int slot                        = scene_graph_slot(graph->node_ids[i]);
+        graph->draw_order[positions[i]] = slot;
+        graph->draw_ranks[slot]         = positions[i];
+    }
+}
+
+void scene_graph_ysort_parallel(SceneGraph* graph, ThreadPool* pool) {
+    assert(graph != NULL && "Graph cannot be NULL");
+
+    // Most frames only a few nodes cross a neighbour, repairing them beats sorting everything
+    if (scene_graph_ysort_incremental(graph)) return;
+
+    // Children are bucketed over storage, which has to be parent-first again after a reparent
+    scene_graph_relayout(graph);
+    gather_children(graph);
+
+    // A parent with more children than a chunk's share is split over every worker instead, the
+    // rest are packed from the front of the parent list and the split ones from the back
+    const int children = graph->nodes_count - 1;
+    int* parents       = graph->sort_parents;
+    int* starts        = graph->sort_positions;
+    int share          = children / parallel_chunks(pool, children, SCENE_GRAPH_YSORT_GRAIN) + 1;
+    int packed         = 0;
+    int split          = graph->capacity;
+    int packed_total   = 0;
+    for (int i = 0; i < graph->nodes_count; i++) {
+        const int count = graph->children_counts[i];
+        if (count < 2) continue;
+
+        if (count > share && count >= SCENE_GRAPH_YSORT_SPLIT) {
+            parents[--split] = i;
+        } else {
+            starts[packed]    = packed_total;
+            parents[packed++] = i;
+            packed_total += count;
+        }
     }
 
-    for (int i = 0; i < temp_drawable_count; i++) {
-        graph->drawables[i]                             = temp_drawables[i];
-        graph->drawable_indices[temp_drawables[i].node] = i;
+    // Packed parents are cut into runs of about the same number of children
+    PackedSort sort = {graph, packed};
+    parallel_for(pool, 0, packed_total, SCENE_GRAPH_YSORT_GRAIN, sort_packed_chunk, &sort);
+
+    for (int p = split; p < graph->capacity; p++) {
+        sort_children(graph, parents[p], pool);
     }
 
-    free(temp_nodes);
-    free(temp_drawables);
-    free(temp_local_positions);
-    free(temp_world_positions);
+    // Preorder draws every parent before its children, storage stays as it is
+    build_order(graph);
+    scene_graph_ysort_settle(graph);
 }
@@ -5,8 +5,24 @@ typedef struct SceneGraph SceneGraph;
 
 typedef struct ThreadPool ThreadPool;
 
-typedef struct thpool_* threadpool;
+// Parents with at least this many children may be sorted by every worker together
+#ifndef SCENE_GRAPH_YSORT_SPLIT
+#define SCENE_GRAPH_YSORT_SPLIT 8192
+#endif
 
-void scene_graph_ysort_parallel(SceneGraph* graph, threadpool pool);
+// Fewest children, or keys of one radix pass, worth handing to a worker of their own
+#ifndef SCENE_GRAPH_YSORT_GRAIN
+#define SCENE_GRAPH_YSORT_GRAIN 2048
+#endif
+
+/**
+ * Sorts every sibling list by layer, then world y, and rebuilds draw_order from them. Frames
+ * where few nodes moved are repaired by scene_graph_ysort_incremental, anything else is radix
+ * sorted with the parents spread over the workers by how many children they hold.
+ *
+ * @param graph Scene graph, with world positions computed for this frame
+ * @param pool Thread pool, NULL sorts on the calling thread
+ */
+void scene_graph_ysort_parallel(SceneGraph* graph, ThreadPool* pool);
 
 #endif  //  LIB_SCENE_GRAPH_PARALLEL_GRAPH_SORT_H_
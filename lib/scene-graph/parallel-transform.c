@@ -0,0 +1,115 @@
+#include "parallel-transform.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene-graph/scene-graph.h"
+#include "thread-pool/parallel.h"
+
+_Static_assert(PARALLEL_MAX_CHUNKS <= SCENE_GRAPH_PARTITIONS_MAX,
+               "Partitions cannot hold every chunk");
+
+static int compare_by_size(const void* a, const void* b) {
+    const PartitionSubtree* sa = a;
+    const PartitionSubtree* sb = b;
+    if (sa->size != sb->size) {
+        return (sa->size < sb->size) - (sa->size > sb->size);
+    }
+
+    return (sa->top > sb->top) - (sa->top < sb->top);
+}
+
+static void scene_graph_partition_build(SceneGraph* graph, int partitions) {
+    const int* parents = graph->parent_indices;
+    const int count    = graph->nodes_count;
+
+    // Every node inherits the top-level subtree (a child of the root) it belongs to
+    int* tops                  = graph->partition_tops;
+    int* owners                = graph->partition_owners;
+    PartitionSubtree* subtrees = graph->partition_subtrees;
+    int subtrees_count         = 0;
+    memset(owners, 0, sizeof(int) * count);
+
+    tops[0] = NODE_NULL;
+    for (int i = 1; i < count; i++) {
+        tops[i] = parents[i] == 0 ? i : tops[parents[i]];
+        owners[tops[i]]++;
+    }
+
+    for (int i = 1; i < count; i++) {
+        if (parents[i] == 0) {
+            subtrees[subtrees_count++] = (PartitionSubtree){.top = i, .size = owners[i]};
+        }
+    }
+
+    // Largest subtree first onto the least loaded job keeps the jobs within one subtree of even
+    qsort(subtrees, subtrees_count, sizeof(PartitionSubtree), compare_by_size);
+
+    int loads[SCENE_GRAPH_PARTITIONS_MAX] = {0};
+    for (int i = 0; i < subtrees_count; i++) {
+        int job = 0;
+        for (int j = 1; j < partitions; j++) {
+            if (loads[j] < loads[job]) job = j;
+        }
+
+        loads[job]              += subtrees[i].size;
+        owners[subtrees[i].top]  = job;
+    }
+
+    // Counting sort by job, walking storage forward keeps every group parent-first
+    int* offsets = graph->partition_offsets;
+    offsets[0]   = 0;
+    for (int j = 0; j < partitions; j++) {
+        offsets[j + 1] = offsets[j] + loads[j];
+    }
+
+    int cursor[SCENE_GRAPH_PARTITIONS_MAX];
+    memcpy(cursor, offsets, sizeof(int) * partitions);
+    for (int i = 1; i < count; i++) {
+        int job                                 = owners[tops[i]];
+        graph->partition_indices[cursor[job]++] = i;
+    }
+
+    graph->partition_version = graph->layout_version;
+    graph->partition_count   = partitions;
+}
+
+// A chunk sweeps a run of partition groups, one after the other
+static void scene_graph_subtree_chunk(void* context, int chunk, int begin, int end) {
+    (void)chunk;
+
+    SceneGraph* graph  = context;
+    const int* offsets = graph->partition_offsets;
+    for (int j = begin; j < end; j++) {
+        scene_graph_sweep_indices(
+            graph, &graph->partition_indices[offsets[j]], offsets[j + 1] - offsets[j]);
+    }
+}
+
+void scene_graph_compute_positions_parallel(SceneGraph* graph, ThreadPool* pool) {
+    assert(graph != NULL && "Graph cannot be NULL");
+
+    if (pool == NULL || graph->nodes_count < SCENE_GRAPH_PARALLEL_THRESHOLD) {
+        scene_graph_compute_positions(graph);
+        return;
+    }
+
+    int first = scene_graph_apply_updates(graph);
+    if (first == graph->nodes_count) return;
+
+    // One group per chunk the pool cuts the nodes into, regrouped when the pool or layout changes
+    int partitions = parallel_chunks(pool, graph->nodes_count, SCENE_GRAPH_PARALLEL_GRAIN);
+    if (graph->partition_version != graph->layout_version || graph->partition_count != partitions) {
+        scene_graph_partition_build(graph, partitions);
+    }
+
+    // The root is shared by every subtree, settle it before any job reads it
+    const int root = 0;
+    scene_graph_sweep_indices(graph, &root, 1);
+
+    // Subtrees never share a node, so chunks only write to storage the others do not read
+    parallel_for(pool, 0, partitions, 1, scene_graph_subtree_chunk, graph);
+
+    scene_graph_sweep_finish(graph, first);
+}
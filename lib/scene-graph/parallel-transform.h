@@ -0,0 +1,23 @@
+#ifndef LIB_SCENE_GRAPH_PARALLEL_TRANSFORM_H_
+#define LIB_SCENE_GRAPH_PARALLEL_TRANSFORM_H_
+
+// Below this many nodes the job overhead outweighs the sweep, stay on the calling thread
+#define SCENE_GRAPH_PARALLEL_THRESHOLD 16384
+
+// Fewest nodes worth a worker of their own, top-level subtrees are grouped into that many chunks
+#define SCENE_GRAPH_PARALLEL_GRAIN 2048
+
+typedef struct SceneGraph SceneGraph;
+
+typedef struct ThreadPool ThreadPool;
+
+/**
+ * Same result as scene_graph_compute_positions, bit for bit, but the subtrees under the root are
+ * spread over every worker of the pool. Small graphs are computed on the calling thread.
+ *
+ * @param graph Scene graph to update
+ * @param pool Thread pool to run the subtree jobs on
+ */
+void scene_graph_compute_positions_parallel(SceneGraph* graph, ThreadPool* pool);
+
+#endif  // LIB_SCENE_GRAPH_PARALLEL_TRANSFORM_H_
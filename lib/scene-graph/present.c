@@ -0,0 +1,122 @@
+#include "present.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+ScenePresent* scene_present_new(void) {
+    ScenePresent* present = calloc(1, sizeof(ScenePresent));
+    assert(present != NULL && "Present cannot be NULL");
+
+    pthread_mutex_init(&present->lock, NULL);
+    pthread_cond_init(&present->changed, NULL);
+    return present;
+}
+
+void scene_present_free(ScenePresent* present) {
+    if (present == NULL) return;
+
+    for (int i = 0; i < 2; i++) {
+        free(present->frames[i].drawables);
+        free(present->frames[i].sources);
+        free(present->frames[i].transforms);
+    }
+
+    pthread_cond_destroy(&present->changed);
+    pthread_mutex_destroy(&present->lock);
+    free(present);
+}
+
+static void present_frame_reserve(PresentFrame* frame, int count) {
+    if (count <= frame->capacity) return;
+
+    int capacity = frame->capacity > 0 ? frame->capacity : 256;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    frame->drawables  = realloc(frame->drawables, sizeof(Drawable) * capacity);
+    frame->sources    = realloc(frame->sources, sizeof(DrawSource) * capacity);
+    frame->transforms = realloc(frame->transforms, sizeof(Transform2D) * capacity);
+    assert(frame->drawables != NULL && frame->sources != NULL && frame->transforms != NULL &&
+           "Failed to grow present frame");
+    frame->capacity = capacity;
+}
+
+bool scene_present_publish(ScenePresent* present, SceneGraph* graph, Bounds view) {
+    assert(present != NULL && "Present cannot be NULL");
+    assert(graph != NULL && "Graph cannot be NULL");
+
+    // Only this thread touches the back frame, the render thread may still be drawing the front
+    PresentFrame* frame = &present->frames[present->front ^ 1];
+    int count           = scene_graph_cull(graph, view);
+    present_frame_reserve(frame, count);
+
+    for (int i = 0; i < count; i++) {
+        int slot             = graph->render_list[graph->visible_drawables[i]];
+        frame->drawables[i]  = graph->drawables[graph->drawable_indices[slot]];
+        frame->transforms[i] = scene_graph_draw_transform_get(graph, frame->drawables[i].node);
+        scene_graph_draw_source_capture(graph, &frame->drawables[i], &frame->sources[i]);
+    }
+
+    frame->count = count;
+    frame->view  = view;
+    memcpy(frame->draw_kinds, graph->draw_kinds, sizeof(frame->draw_kinds));
+
+    pthread_mutex_lock(&present->lock);
+    while (!present->closed && (present->fresh || present->reading)) {
+        pthread_cond_wait(&present->changed, &present->lock);
+    }
+
+    bool closed = present->closed;
+    if (!closed) {
+        present->front ^= 1;
+        present->fresh  = true;
+        pthread_cond_broadcast(&present->changed);
+    }
+
+    pthread_mutex_unlock(&present->lock);
+    return !closed;
+}
+
+const PresentFrame* scene_present_acquire(ScenePresent* present) {
+    assert(present != NULL && "Present cannot be NULL");
+
+    pthread_mutex_lock(&present->lock);
+    while (!present->closed && !present->fresh) {
+        pthread_cond_wait(&present->changed, &present->lock);
+    }
+
+    const PresentFrame* frame = NULL;
+    if (!present->closed) {
+        present->fresh   = false;
+        present->reading = true;
+        frame            = &present->frames[present->front];
+    }
+
+    pthread_mutex_unlock(&present->lock);
+    return frame;
+}
+
+void scene_present_release(ScenePresent* present) {
+    assert(present != NULL && "Present cannot be NULL");
+
+    pthread_mutex_lock(&present->lock);
+    present->reading = false;
+    pthread_cond_broadcast(&present->changed);
+    pthread_mutex_unlock(&present->lock);
+}
+
+void scene_present_draw(const PresentFrame* frame) {
+    scene_graph_draw_runs(
+        frame->drawables, frame->sources, frame->transforms, frame->count, frame->draw_kinds);
+}
+
+void scene_present_close(ScenePresent* present) {
+    assert(present != NULL && "Present cannot be NULL");
+
+    pthread_mutex_lock(&present->lock);
+    present->closed = true;
+    pthread_cond_broadcast(&present->changed);
+    pthread_mutex_unlock(&present->lock);
+}
@@ -0,0 +1,70 @@
+#ifndef LIB_SCENE_GRAPH_PRESENT_H_
+#define LIB_SCENE_GRAPH_PRESENT_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+
+#include "scene-graph/scene-graph.h"
+
+// Everything a render needs from one simulation step, the visible drawables in draw order with
+// the world transform and draw source they had when the step was published
+typedef struct PresentFrame {
+    Drawable* drawables;
+    DrawSource* sources;
+    Transform2D* transforms;
+    int count;
+    int capacity;
+    Bounds view;
+    DrawableDrawBatch draw_kinds[SCENE_GRAPH_KINDS];
+} PresentFrame;
+
+// Front and back frame of a graph. The simulation thread fills the back frame and swaps it to the
+// front once the render thread is done with the last one, so one step is being simulated while
+// the previous one is drawn.
+typedef struct ScenePresent {
+    PresentFrame frames[2];
+    int front;
+    bool fresh;    // the front frame has not been acquired yet
+    bool reading;  // the render thread holds the front frame
+    bool closed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} ScenePresent;
+
+ScenePresent* scene_present_new(void);
+
+void scene_present_free(ScenePresent* present);
+
+/**
+ * Copies the drawables inside the view and their world transforms into the back frame, then
+ * swaps it to the front. Blocks while the render thread has not taken the last frame yet, which
+ * keeps the simulation at most one step ahead of what is on screen.
+ *
+ * Drawables are copied, whatever their data points to is not. Batches draw from the sources
+ * captured here, only custom draws read the data, which then must outlive the frame and only
+ * change in ways a draw can race.
+ *
+ * @param present Presentation buffers of the graph
+ * @param graph Scene graph after transforms and sorting, owned by the calling thread
+ * @param view Bounds to cull against, handed on to the render thread with the frame
+ * @return false once the present was closed, the frame is dropped
+ */
+bool scene_present_publish(ScenePresent* present, SceneGraph* graph, Bounds view);
+
+/**
+ * Waits for a frame that has not been drawn yet and hands it to the render thread, which owns it
+ * until scene_present_release.
+ *
+ * @return The front frame, or NULL once the present was closed
+ */
+const PresentFrame* scene_present_acquire(ScenePresent* present);
+
+void scene_present_release(ScenePresent* present);
+
+// Draws every drawable of the frame in order, runs of a registered kind as one batch
+void scene_present_draw(const PresentFrame* frame);
+
+// Wakes both threads for good, publish and acquire fail from here on
+void scene_present_close(ScenePresent* present);
+
+#endif  // LIB_SCENE_GRAPH_PRESENT_H_
@@ -1,256 +1,1320 @@
 #include "scene-graph.h"
 
 #include <assert.h>
+#include <math.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "scene-graph/graph-sort.h"
+#include "scene-graph/spatial-grid.h"
+#include "scene-graph/transform-kernel.h"
+
+// Widest element of the node arrays scene_graph_storage_permute gathers through its scratch
+#define SCENE_GRAPH_PERMUTE_WIDTH (sizeof(SceneNode) > sizeof(Transform2D) ? sizeof(SceneNode) : sizeof(Transform2D))
+
+static void scene_graph_game_object_move(SceneGraph *graph, int from, int to) {
+    if (from == to) return;
+
+    graph->game_objects[to]                                                    = graph->game_objects[from];
+    graph->game_object_indices[scene_graph_slot(graph->game_objects[to].node)] = to;
+}
+
+// Files the object at the first unfiled index under its kind. Every later kind hands its first
+// object to its own end, which opens a hole at the end of the kind in one move per kind.
+static void scene_graph_game_object_file(SceneGraph *graph) {
+    int *offsets      = graph->game_object_offsets;
+    GameObject object = graph->game_objects[offsets[SCENE_GRAPH_KINDS]];
+
+    int hole = offsets[SCENE_GRAPH_KINDS];
+    for (int kind = SCENE_GRAPH_KINDS - 1; kind > object.kind; kind--) {
+        scene_graph_game_object_move(graph, offsets[kind], hole);
+        hole = offsets[kind]++;
+    }
+
+    offsets[SCENE_GRAPH_KINDS]++;
+    graph->game_objects[hole]                                 = object;
+    graph->game_object_indices[scene_graph_slot(object.node)] = hole;
+}
+
+static void scene_graph_game_object_remove(SceneGraph *graph, Node node) {
+    int game_object_index = graph->game_object_indices[scene_graph_slot(node)];
+    if (game_object_index == NODE_NULL) return;
+
+    GameObject *object = &graph->game_objects[game_object_index];
+    if (object->destroy != NULL) {
+        object->destroy(graph, object);
+    }
+
+    // Unfiled objects are only packed, filed ones close the hole with the last object of their
+    // kind and every later kind hands its last object to its own front
+    int *offsets = graph->game_object_offsets;
+    int hole     = game_object_index;
+    if (hole < offsets[SCENE_GRAPH_KINDS]) {
+        for (int kind = graph->game_objects[hole].kind; kind < SCENE_GRAPH_KINDS; kind++) {
+            scene_graph_game_object_move(graph, offsets[kind + 1] - 1, hole);
+            hole = --offsets[kind + 1];
+        }
+    }
+
+    scene_graph_game_object_move(graph, graph->game_objects_count - 1, hole);
+    graph->game_object_indices[scene_graph_slot(node)] = NODE_NULL;
+    graph->game_objects_count--;
+}
+
+static void scene_graph_drawable_remove(SceneGraph *graph, Node node) {
+    int drawable_index = graph->drawable_indices[scene_graph_slot(node)];
+    if (drawable_index == NODE_NULL) return;
+
+    Drawable *drawable = &graph->drawables[drawable_index];
+    if (drawable->destroy != NULL) {
+        drawable->destroy(graph, drawable);
+    }
+
+    spatial_grid_remove(graph->grid, scene_graph_slot(node));
+    graph->render_list_dirty = true;
+
+    // Draw order lives in draw_order, swap the last drawable into the hole to keep the array packed
+    int last_drawable_index                          = graph->drawables_count - 1;
+    graph->drawables[drawable_index]                 = graph->drawables[last_drawable_index];
+    Node moved                                       = graph->drawables[drawable_index].node;
+    graph->drawable_indices[scene_graph_slot(moved)] = drawable_index;
+    graph->drawable_indices[scene_graph_slot(node)]  = NODE_NULL;
+    graph->drawables_count--;
+}
+
+static Node scene_graph_handle_new(SceneGraph *graph) {
+    if (graph->free_slots_count == 0 &&
+        !scene_graph_reserve(graph, graph->capacity + SCENE_GRAPH_PAGE_SIZE)) {
+        return NODE_NULL;
+    }
+
+    int slot = graph->free_slots[--graph->free_slots_count];
+    return graph->node_handles[slot];
+}
+
+void scene_graph_handle_free(SceneGraph *graph, Node node) {
+    assert(scene_graph_node_valid(graph, node) && "Node handle was not acquired from this graph");
+    int slot       = scene_graph_slot(node);
+    int generation = ((node >> NODE_INDEX_BITS) + 1) & NODE_GENERATION_MASK;
+
+    // The slot holds the next handle to hand out, which nobody can be holding yet
+    graph->node_handles[slot]                    = (generation << NODE_INDEX_BITS) | slot;
+    graph->update_indices[slot]                  = NODE_NULL;
+    graph->free_slots[graph->free_slots_count++] = slot;
+}
+
+static void scene_graph_node_link(SceneGraph *graph, Node node, Node parent) {
+    SceneNode *child = scene_graph_node_get(graph, node);
+    SceneNode *owner = scene_graph_node_get(graph, parent);
+
+    child->parent       = parent;
+    child->prev_sibling = owner->last_child;
+    child->next_sibling = NODE_NULL;
+
+    if (owner->last_child == NODE_NULL) {
+        owner->first_child = node;
+    } else {
+        scene_graph_node_get(graph, owner->last_child)->next_sibling = node;
+    }
+
+    owner->last_child = node;
+    graph->children_counts[scene_graph_index_get(graph, parent)]++;
+}
+
+static void scene_graph_node_unlink(SceneGraph *graph, Node node) {
+    SceneNode *child = scene_graph_node_get(graph, node);
+    SceneNode *owner = scene_graph_node_get(graph, child->parent);
+
+    if (child->prev_sibling == NODE_NULL) {
+        owner->first_child = child->next_sibling;
+    } else {
+        scene_graph_node_get(graph, child->prev_sibling)->next_sibling = child->next_sibling;
+    }
+
+    if (child->next_sibling == NODE_NULL) {
+        owner->last_child = child->prev_sibling;
+    } else {
+        scene_graph_node_get(graph, child->next_sibling)->prev_sibling = child->prev_sibling;
+    }
+
+    graph->children_counts[scene_graph_index_get(graph, child->parent)]--;
+    child->prev_sibling = NODE_NULL;
+    child->next_sibling = NODE_NULL;
+}
 
 void scene_graph_remove_destroyed_nodes(SceneGraph *graph) {
+    assert(graph != NULL && "Graph cannot be NULL");
+    if (graph->nodes_to_destroy_count == 0) return;
+
+    scene_graph_relayout(graph);
+
+    // The dirty flags are only used inside scene_graph_compute_positions, borrow them as marks
+    uint8_t *marks = graph->dirty_flags;
+    int first      = graph->nodes_count;
     for (int i = 0; i < graph->nodes_to_destroy_count; i++) {
-        // Swap the node with the last node in the array to keep it packed
-        Node node                = graph->nodes_to_destroy[i];
-        int node_index           = scene_graph_index_get(graph, node);
-        int last_node_index      = graph->nodes_count - 1;
-        graph->nodes[node_index] = graph->nodes[last_node_index];
-
-        scene_graph_index_set(graph, last_node_index, node_index);
-        scene_graph_index_set(graph, node_index, NODE_NULL);
-        graph->nodes_count--;
-
-        // Swap and potentially remove the game object
-        int game_object_index = graph->game_object_indices[node_index];
-        if (game_object_index != NODE_NULL) {
-            GameObject *object = &graph->game_objects[game_object_index];
-            if (object->destroy != NULL) {
-                object->destroy(graph, object);
-            }
+        int index = scene_graph_index_get(graph, graph->nodes_to_destroy[i]);
+        if (index == NODE_NULL) continue;
 
-            int last_game_object_index             = graph->game_objects_count - 1;
-            graph->game_objects[game_object_index] = graph->game_objects[last_game_object_index];
-            graph->game_object_indices[last_game_object_index] = game_object_index;
-            graph->game_object_indices[node_index]             = NODE_NULL;
-            graph->game_objects_count--;
-        }
+        marks[index] = 1;
+        first        = index < first ? index : first;
+    }
 
-        // Swap and potentially remove the drawable
-        int drawable_index = graph->drawable_indices[node_index];
-        if (drawable_index != NODE_NULL) {
-            Drawable *drawable = &graph->drawables[drawable_index];
-            if (drawable->destroy != NULL) {
-                drawable->destroy(graph, drawable);
+    // Children are stored after their parents, so one forward pass marks every subtree
+    for (int i = first + 1; i < graph->nodes_count; i++) {
+        marks[i] |= marks[graph->parent_indices[i]];
+    }
+
+    for (int i = first; i < graph->nodes_count; i++) {
+        if (marks[i]) {
+            // Only the top of each removed subtree has a surviving parent to unlink from
+            int parent = graph->parent_indices[i];
+            if (parent != NODE_NULL && !marks[parent]) {
+                scene_graph_node_unlink(graph, graph->node_ids[i]);
             }
 
-            int last_drawable_index                      = graph->drawables_count - 1;
-            graph->drawables[drawable_index]             = graph->drawables[last_drawable_index];
-            graph->drawable_indices[last_drawable_index] = drawable_index;
-            graph->drawable_indices[node_index]          = NODE_NULL;
-            graph->drawables_count--;
+            scene_graph_game_object_remove(graph, graph->node_ids[i]);
+            scene_graph_drawable_remove(graph, graph->node_ids[i]);
+            scene_graph_journal_record(graph, graph->node_ids[i], SCENE_CHANGE_DESTROYED);
+            graph->affine_count -= (graph->transform_flags[i] & TRANSFORM_LOCAL_AFFINE) != 0;
+        }
+    }
+
+    // Compact the survivors in place without reordering them, parents stay ahead of children.
+    // The root is never among them: it is either before the first mark or marked itself.
+    int count = first;
+    for (int i = first; i < graph->nodes_count; i++) {
+        Node node = graph->node_ids[i];
+        if (marks[i]) {
+            marks[i] = 0;
+            scene_graph_index_set(graph, node, NODE_NULL);
+            scene_graph_handle_free(graph, node);
+            continue;
         }
+
+        Node parent                    = graph->nodes[i].parent;
+        graph->nodes[count]            = graph->nodes[i];
+        graph->local_positions[count]  = graph->local_positions[i];
+        graph->world_positions[count]  = graph->world_positions[i];
+        graph->local_rotations[count]  = graph->local_rotations[i];
+        graph->local_scales[count]     = graph->local_scales[i];
+        graph->transform_flags[count]  = graph->transform_flags[i];
+        graph->world_transforms[count] = graph->world_transforms[i];
+        graph->node_ids[count]         = node;
+        graph->children_counts[count]  = graph->children_counts[i];
+        graph->parent_indices[count]   = scene_graph_index_get(graph, parent);
+        scene_graph_index_set(graph, node, count);
+        count++;
+    }
+
+    // Whole subtrees are gone, what is left of the draw order is still a preorder
+    int drawn = 0;
+    for (int rank = 0; rank < graph->nodes_count; rank++) {
+        int slot = graph->draw_order[rank];
+        if (graph->node_indices[slot] == NODE_NULL) continue;
+
+        graph->draw_order[drawn] = slot;
+        graph->draw_ranks[slot]  = drawn++;
     }
+
+    graph->nodes_count            = count;
+    graph->nodes_to_destroy_count = 0;
+    graph->layout_version++;
 }
 
-static int scene_graph_next_index(int *array, int *index) {
-    assert(array != NULL && "Array cannot be NULL");
-    assert(index != NULL && "Index cannot be NULL");
+// Gathers index and its ancestors into the resolve chain, leaf first, and returns how many
+static int scene_graph_resolve_chain(SceneGraph *graph, int index) {
+    int count = 0;
+    for (int i = index; i != NODE_NULL; i = graph->parent_indices[i]) {
+        graph->resolve_chain[count++] = i;
+    }
 
-    int start = *index;
+    return count;
+}
 
-    while (array[*index] != NODE_NULL) {
-        *index = (*index + 1) % MAX_NODES;
-        if (*index == start) {
-            assert(0 && "Overflow");
-        }
+static Position scene_graph_world_position_resolve(SceneGraph *graph, int index) {
+    const int *chain = graph->resolve_chain;
+    int count        = scene_graph_resolve_chain(graph, index);
+
+    // Summed root-first, the same order the sweep below uses, so results match bit for bit
+    Position world = graph->local_positions[chain[count - 1]];
+    for (int i = count - 2; i >= 0; i--) {
+        Position local = graph->local_positions[chain[i]];
+        world.x        = world.x + local.x;
+        world.y        = world.y + local.y;
     }
 
-    int result = *index;
-    *index     = (result + 1) % MAX_NODES;
-    return result;
+    return world;
 }
 
-inline static void scene_graph_compute_node_position(SceneGraph *graph, Node node) {
-    int index  = scene_graph_index_get(graph, node);
-    int parent = scene_graph_parent_get(graph, node);
-    if (parent != NODE_NULL) {
-        int parent_index              = scene_graph_index_get(graph, parent);
-        Position world_pos            = graph->world_positions[parent_index];
-        Position local_pos            = graph->local_positions[index];
-        graph->world_positions[index] = (Position){
-            .x = world_pos.x + local_pos.x,
-            .y = world_pos.y + local_pos.y,
+static Transform2D transform_translation(float x, float y) {
+    return (Transform2D){.a = 1.0f, .d = 1.0f, .tx = x, .ty = y};
+}
+
+static Transform2D transform_multiply(const Transform2D *p, const Transform2D *l) {
+    return (Transform2D){
+        .a  = p->a * l->a + p->c * l->b,
+        .b  = p->b * l->a + p->d * l->b,
+        .c  = p->a * l->c + p->c * l->d,
+        .d  = p->b * l->c + p->d * l->d,
+        .tx = p->a * l->tx + p->c * l->ty + p->tx,
+        .ty = p->b * l->tx + p->d * l->ty + p->ty,
+    };
+}
+
+static Transform2D scene_graph_local_transform(const SceneGraph *graph, int index) {
+    float rotation = graph->local_rotations[index];
+    Scale scale    = graph->local_scales[index];
+    Position pos   = graph->local_positions[index];
+    float cs       = cosf(rotation);
+    float sn       = sinf(rotation);
+
+    return (Transform2D){
+        .a  = cs * scale.x,
+        .b  = sn * scale.x,
+        .c  = -sn * scale.y,
+        .d  = cs * scale.y,
+        .tx = pos.x,
+        .ty = pos.y,
+    };
+}
+
+// Shared by the sweep and the resolver below so both produce the same bits. Returns whether the
+// world transform has a linear part, translation-only nodes under translation-only parents are
+// the same sum the translation kernel computes.
+static bool scene_graph_transform_compose(const SceneGraph *graph,
+                                          int index,
+                                          const Transform2D *parent,
+                                          bool parent_affine,
+                                          Transform2D *world) {
+    if (!parent_affine && !(graph->transform_flags[index] & TRANSFORM_LOCAL_AFFINE)) {
+        Position pos = graph->local_positions[index];
+        *world       = transform_translation(parent->tx + pos.x, parent->ty + pos.y);
+        return false;
+    }
+
+    Transform2D local = scene_graph_local_transform(graph, index);
+    *world            = transform_multiply(parent, &local);
+    return true;
+}
+
+static bool scene_graph_world_transform_resolve(SceneGraph *graph, int index, Transform2D *world) {
+    const int *chain         = graph->resolve_chain;
+    int count                = scene_graph_resolve_chain(graph, index);
+    Transform2D parent_world = transform_translation(0.0f, 0.0f);
+    bool affine              = false;
+
+    // Composed root-first like the sweep, every step is the parent of the next one
+    for (int i = count - 1; i >= 0; i--) {
+        affine       = scene_graph_transform_compose(graph, chain[i], &parent_world, affine, world);
+        parent_world = *world;
+    }
+
+    return affine;
+}
+
+static void scene_graph_local_affine_apply(SceneGraph *graph, int index, const UpdatedSceneNode *update) {
+    if (update->fields & NODE_UPDATE_ROTATION) {
+        graph->local_rotations[index] = update->rotation;
+    }
+
+    if (update->fields & NODE_UPDATE_SCALE) {
+        graph->local_scales[index] = (Scale){
+            .x = update->scale_x,
+            .y = update->scale_y,
         };
+    }
+
+    Scale scale  = graph->local_scales[index];
+    bool affine  = graph->local_rotations[index] != 0.0f || scale.x != 1.0f || scale.y != 1.0f;
+    uint8_t flag = graph->transform_flags[index];
+
+    graph->affine_count          += affine - ((flag & TRANSFORM_LOCAL_AFFINE) != 0);
+    graph->transform_flags[index] = affine ? flag | TRANSFORM_LOCAL_AFFINE : flag & ~TRANSFORM_LOCAL_AFFINE;
+}
+
+static int compare_by_index(const void *a, const void *b) {
+    const UpdatedSceneNode *ua = a;
+    const UpdatedSceneNode *ub = b;
+    return (ua->node > ub->node) - (ua->node < ub->node);
+}
+
+static void scene_graph_sweep_positions(SceneGraph *graph, int first) {
+    const int *parents = graph->parent_indices;
+    const Position *lp = graph->local_positions;
+    Position *wp       = graph->world_positions;
+    uint8_t *dirty     = graph->dirty_flags;
+    const int count    = graph->nodes_count;
+
+    if (first == 0) {
+        // Full rebuild, the root is always stored first and everything below it is dirty
+        wp[0] = lp[0];
+        scene_graph_transform_kernel(wp, lp, parents, 1, count);
+        memset(dirty, 1, count);
     } else {
-        graph->world_positions[index] = graph->local_positions[index];
+        // Dirty range, a node is recomputed when it or its parent changed this frame
+        scene_graph_transform_kernel_dirty(wp, lp, parents, dirty, first, count);
     }
+
+    scene_graph_sweep_finish(graph, first);
 }
 
-static void scene_graph_compute_position_recursive(SceneGraph *graph, Node node) {
-    // Compute the current node's position
-    scene_graph_compute_node_position(graph, node);
+static void scene_graph_transform_node(SceneGraph *graph, int index) {
+    const int parent = graph->parent_indices[index];
+    uint8_t *flags   = graph->transform_flags;
+    uint8_t *dirty   = graph->dirty_flags;
+    if (!dirty[index] && (parent == NODE_NULL || !dirty[parent])) return;
+    dirty[index] = 1;
+
+    Transform2D parent_world = transform_translation(0.0f, 0.0f);
+    bool parent_affine       = false;
+    if (parent != NODE_NULL) {
+        Position pos  = graph->world_positions[parent];
+        parent_affine = flags[parent] & TRANSFORM_WORLD_AFFINE;
+        parent_world  = parent_affine ? graph->world_transforms[parent] : transform_translation(pos.x, pos.y);
+    }
+
+    Transform2D world;
+    bool affine                   = scene_graph_transform_compose(graph, index, &parent_world, parent_affine, &world);
+    graph->world_positions[index] = (Position){
+        .x = world.tx,
+        .y = world.ty,
+    };
 
-    // Traverse over children
-    int next = scene_graph_first_child_get(graph, node);
-    while (next != NODE_NULL) {
-        scene_graph_compute_position_recursive(graph, next);
-        next = scene_graph_sibling_get(graph, next);
+    if (affine) {
+        graph->world_transforms[index] = world;
+        flags[index]                  |= TRANSFORM_WORLD_AFFINE;
+    } else {
+        flags[index] &= ~TRANSFORM_WORLD_AFFINE;
     }
 }
 
-void scene_graph_compute_positions(SceneGraph *graph) {
+static void scene_graph_sweep_transforms(SceneGraph *graph, int first) {
+    // Same forward pass as the kernel, but composing matrices wherever a node or one of its
+    // ancestors is rotated or scaled. Everything else stays a plain sum of positions.
+    for (int i = first; i < graph->nodes_count; i++) {
+        scene_graph_transform_node(graph, i);
+    }
+
+    scene_graph_sweep_finish(graph, first);
+}
+
+void scene_graph_sweep_indices(SceneGraph *graph, const int *indices, int count) {
+    const int *parents = graph->parent_indices;
+    const Position *lp = graph->local_positions;
+    Position *wp       = graph->world_positions;
+    uint8_t *dirty     = graph->dirty_flags;
+
+    // Runs of consecutive indices go through the kernel, which only looks back at parents
+    int i = 0;
+    while (i < count) {
+        int begin = indices[i++];
+        int end   = begin + 1;
+        while (i < count && indices[i] == end) {
+            end++;
+            i++;
+        }
+
+        if (graph->affine) {
+            for (int j = begin; j < end; j++) {
+                scene_graph_transform_node(graph, j);
+            }
+            continue;
+        }
+
+        if (begin == 0) {
+            if (dirty[0]) wp[0] = lp[0];
+            begin = 1;
+        }
+
+        scene_graph_transform_kernel_dirty(wp, lp, parents, dirty, begin, end);
+    }
+}
+
+static void scene_graph_drawable_refresh(SceneGraph *graph, const Drawable *drawable) {
+    Transform2D t = scene_graph_transform_get(graph, drawable->node);
+    Bounds b      = drawable->bounds;
+
+    // Axis aligned box around the transformed corners, a plain offset for translation-only nodes
+    float x0 = t.a * b.x + t.c * b.y + t.tx;
+    float y0 = t.b * b.x + t.d * b.y + t.ty;
+    float wx = t.a * b.width;
+    float wy = t.b * b.width;
+    float hx = t.c * b.height;
+    float hy = t.d * b.height;
+
+    Bounds world = {
+        .x      = x0 + fminf(wx, 0.0f) + fminf(hx, 0.0f),
+        .y      = y0 + fminf(wy, 0.0f) + fminf(hy, 0.0f),
+        .width  = fabsf(wx) + fabsf(hx),
+        .height = fabsf(wy) + fabsf(hy),
+    };
+
+    spatial_grid_update(graph->grid, scene_graph_slot(drawable->node), world);
+}
+
+static void scene_graph_sort_queue_slot(SceneGraph *graph, int slot) {
+    if (graph->sort_queued[slot]) return;
+    graph->sort_queued[slot]                     = 1;
+    graph->sort_queue[graph->sort_queue_count++] = slot;
+}
+
+void scene_graph_sort_queue(SceneGraph *graph, Node node) {
+    assert(scene_graph_node_valid(graph, node) && "Node handle is stale");
+    scene_graph_sort_queue_slot(graph, scene_graph_slot(node));
+}
+
+void scene_graph_journal_record(SceneGraph *graph, Node node, int changes) {
+    int slot  = scene_graph_slot(node);
+    int entry = graph->journal_indices[slot];
+    if (entry != NODE_NULL && entry < graph->journal_count && graph->journal[entry].node == node) {
+        graph->journal[entry].changes |= changes;
+        return;
+    }
+
+    if (graph->journal_count == graph->journal_capacity) {
+        graph->journal_capacity *= 2;
+        graph->journal           = realloc(graph->journal, sizeof(SceneJournalEntry) * graph->journal_capacity);
+        assert(graph->journal != NULL && "Failed to grow the journal");
+    }
+
+    graph->journal_indices[slot]           = graph->journal_count;
+    graph->journal[graph->journal_count++] = (SceneJournalEntry){node, changes};
+}
+
+void scene_graph_sweep_finish(SceneGraph *graph, int first) {
+    uint8_t *dirty = graph->dirty_flags;
+
+    for (int i = first; i < graph->nodes_count; i++) {
+        if (!dirty[i]) continue;
+
+        scene_graph_journal_record(graph, graph->node_ids[i], SCENE_CHANGE_MOVED);
+
+        // Only a changed y can move a node among its siblings, static layers do not care about it
+        int slot = scene_graph_slot(graph->node_ids[i]);
+        if (graph->layer_ysort[graph->nodes[i].layer] && graph->world_positions[i].y != graph->sort_y[slot]) {
+            scene_graph_sort_queue_slot(graph, slot);
+        }
+
+        int drawable_index = graph->drawable_indices[slot];
+        if (drawable_index != NODE_NULL) {
+            scene_graph_drawable_refresh(graph, &graph->drawables[drawable_index]);
+        }
+    }
+
+    memset(&dirty[first], 0, graph->nodes_count - first);
+}
+
+int scene_graph_apply_updates(SceneGraph *graph) {
     assert(graph != NULL && "Graph must not be NULL");
+    scene_graph_relayout(graph);
 
+    // Local writes land directly, world writes wait until their parents are final
+    int first       = graph->nodes_count;
+    int world_count = 0;
     for (int i = 0; i < graph->updated_nodes_count; i++) {
         UpdatedSceneNode update = graph->updated_nodes[i];
-        assert(update.node >= 0 && update.node < graph->nodes_count && "Overflow node index");
+        int slot                = scene_graph_slot(update.node);
 
-        int parent = scene_graph_parent_get(graph, update.node);
-        int index  = scene_graph_index_get(graph, update.node);
-        if (update.type == NODE_WORLD && parent != NODE_NULL) {
-            assert(parent >= 0 && parent < graph->nodes_count && "Overflow parent");
+        // Entries of destroyed nodes are orphaned, their slot may already queue for a new node
+        if (graph->update_indices[slot] == i) {
+            graph->update_indices[slot] = NODE_NULL;
+        }
 
-            int parent_index              = scene_graph_index_get(graph, parent);
-            Position pw_pos               = graph->world_positions[parent_index];
-            graph->local_positions[index] = (Position){
-                .x = update.x - pw_pos.x,
-                .y = update.y - pw_pos.y,
-            };
+        int index = scene_graph_index_get(graph, update.node);
+        if (index == NODE_NULL) continue;  // destroyed before the write was applied
+
+        graph->dirty_flags[index] = 1;
+        first                     = index < first ? index : first;
+
+        if (update.fields & (NODE_UPDATE_ROTATION | NODE_UPDATE_SCALE)) {
+            scene_graph_local_affine_apply(graph, index, &update);
+        }
+
+        if (!(update.fields & NODE_UPDATE_POSITION)) continue;
+
+        if (update.type == NODE_WORLD && graph->parent_indices[index] != NODE_NULL) {
+            // Reuse the node field for the storage index, which orders parents first
+            update.node                         = index;
+            graph->updated_nodes[world_count++] = update;
         } else {
             graph->local_positions[index] = (Position){
                 .x = update.x,
                 .y = update.y,
             };
         }
+    }
+
+    // Switching between the translation kernel and the affine sweep rebuilds every node once,
+    // world transforms are only kept up to date while some node is rotated or scaled
+    bool affine = graph->affine_count > 0;
+    if (affine != graph->affine && graph->nodes_count > 0) {
+        graph->affine         = affine;
+        graph->dirty_flags[0] = 1;
+        first                 = 0;
+    }
+
+    qsort(graph->updated_nodes, world_count, sizeof(UpdatedSceneNode), compare_by_index);
+
+    for (int i = 0; i < world_count; i++) {
+        UpdatedSceneNode update = graph->updated_nodes[i];
+        int index               = update.node;
+        int parent_index        = graph->parent_indices[index];
+
+        if (!graph->affine) {
+            Position pw_pos               = scene_graph_world_position_resolve(graph, parent_index);
+            graph->local_positions[index] = (Position){
+                .x = update.x - pw_pos.x,
+                .y = update.y - pw_pos.y,
+            };
+            continue;
+        }
+
+        // Bring the target into the parent's space through the inverse of its world transform
+        Transform2D pw;
+        scene_graph_world_transform_resolve(graph, parent_index, &pw);
+        float det = pw.a * pw.d - pw.b * pw.c;
+        float dx  = update.x - pw.tx;
+        float dy  = update.y - pw.ty;
+
+        // A parent scaled to zero maps every local position to one point, keep the offset as is
+        // rather than dropping the write
+        if (det == 0.0f) {
+            graph->local_positions[index] = (Position){dx, dy};
+            continue;
+        }
 
-        scene_graph_compute_position_recursive(graph, update.node);
+        graph->local_positions[index] = (Position){
+            .x = (pw.d * dx - pw.c * dy) / det,
+            .y = (pw.a * dy - pw.b * dx) / det,
+        };
     }
 
     graph->updated_nodes_count = 0;
+    return first;
+}
+
+void scene_graph_compute_positions(SceneGraph *graph) {
+    int first = scene_graph_apply_updates(graph);
+    if (first == graph->nodes_count) return;
+
+    if (graph->affine) {
+        scene_graph_sweep_transforms(graph, first);
+    } else {
+        scene_graph_sweep_positions(graph, graph->dirty_flags[0] ? 0 : first);
+    }
+}
+
+int scene_graph_update_kind_register(SceneGraph *graph, GameObjectUpdateBatch update) {
+    assert(update != NULL && "Update batch cannot be NULL");
+    assert(graph->update_kinds_count < SCENE_GRAPH_KINDS && "Too many update kinds");
+
+    graph->update_kinds[graph->update_kinds_count] = update;
+    return graph->update_kinds_count++;
+}
+
+int scene_graph_draw_kind_register(SceneGraph *graph,
+                                   DrawableDrawBatch draw,
+                                   DrawableCapture capture) {
+    assert(draw != NULL && "Draw batch cannot be NULL");
+    assert(graph->draw_kinds_count < SCENE_GRAPH_KINDS && "Too many draw kinds");
+
+    graph->draw_kinds[graph->draw_kinds_count]    = draw;
+    graph->draw_captures[graph->draw_kinds_count] = capture;
+    return graph->draw_kinds_count++;
+}
+
+void scene_graph_draw_source_capture(const SceneGraph *graph,
+                                     const Drawable *drawable,
+                                     DrawSource *source) {
+    *source                 = (DrawSource){0};
+    DrawableCapture capture = graph->draw_captures[drawable->kind];
+    if (capture != NULL) {
+        capture(drawable, source);
+    }
+}
+
+GameObject *scene_graph_game_object_new_kind(SceneGraph *graph, Node node, int kind) {
+    assert(scene_graph_node_valid(graph, node) && "Invalid Node?");
+    assert(graph->game_objects_count < graph->capacity && "Game object overflow");
+    assert(kind >= 0 && kind < graph->update_kinds_count && "Update kind was never registered");
+
+    // Appended unfiled, filed right away unless an update pass is walking the kinds
+    int index                                          = graph->game_objects_count++;
+    graph->game_object_indices[scene_graph_slot(node)] = index;
+    graph->game_objects[index]                         = (GameObject){.node = node, .kind = kind};
+    if (graph->updating) return &graph->game_objects[index];
+
+    scene_graph_game_object_file(graph);
+    return &graph->game_objects[graph->game_object_indices[scene_graph_slot(node)]];
 }
 
 GameObject *scene_graph_game_object_new(SceneGraph *graph, Node node) {
-    assert(node >= 0 && "Invalid Node?");
-    assert(graph->game_objects_count < MAX_NODES && "Game object overflow");
+    return scene_graph_game_object_new_kind(graph, node, SCENE_GRAPH_KIND_CUSTOM);
+}
 
-    graph->game_object_indices[node] = graph->game_objects_count;
-    GameObject *object               = &graph->game_objects[graph->game_objects_count++];
-    object->node                     = node;
-    object->data                     = NULL;
-    object->update                   = NULL;
-    object->destroy                  = NULL;
-    return object;
+Drawable *scene_graph_drawable_new_kind(SceneGraph *graph, Node node, int kind) {
+    assert(scene_graph_node_valid(graph, node) && "Invalid Node?");
+    assert(graph->drawables_count < graph->capacity && "Drawable overflow");
+    assert(kind >= 0 && kind < graph->draw_kinds_count && "Draw kind was never registered");
+
+    graph->drawable_indices[scene_graph_slot(node)] = graph->drawables_count;
+    Drawable *drawable                              = &graph->drawables[graph->drawables_count++];
+    drawable->node                                  = node;
+    drawable->kind                                  = kind;
+    drawable->data                                  = NULL;
+    drawable->destroy                               = NULL;
+    drawable->draw                                  = NULL;
+    drawable->bounds                                = (Bounds){0};
+    graph->render_list_dirty                        = true;
+
+    scene_graph_drawable_refresh(graph, drawable);
+    return drawable;
 }
 
 Drawable *scene_graph_drawable_new(SceneGraph *graph, Node node) {
-    assert(node >= 0 && "Invalid Node?");
-    assert(graph->drawables_count < MAX_NODES && "Drawable overflow");
-
-    graph->drawable_indices[node] = graph->drawables_count;
-    Drawable *drawable            = &graph->drawables[graph->drawables_count++];
-    drawable->node                = node;
-    drawable->data                = NULL;
-    drawable->destroy             = NULL;
-    drawable->draw                = NULL;
-    return drawable;
+    return scene_graph_drawable_new_kind(graph, node, SCENE_GRAPH_KIND_CUSTOM);
 }
 
-Node scene_graph_node_new(SceneGraph *graph, Node parent) {
+void scene_graph_drawable_bounds_set(SceneGraph *graph, Node node, Bounds bounds) {
+    int drawable_index = graph->drawable_indices[scene_graph_slot(node)];
+    assert(drawable_index != NODE_NULL && "Node has no drawable");
+
+    graph->drawables[drawable_index].bounds = bounds;
+    scene_graph_drawable_refresh(graph, &graph->drawables[drawable_index]);
+}
+
+void scene_graph_layer_ysort_set(SceneGraph *graph, int layer, bool ysort) {
+    assert(layer >= 0 && layer < SCENE_GRAPH_LAYERS && "Layer is out of range");
+    if (graph->layer_ysort[layer] == ysort) return;
+
+    // Nodes of a static layer were never queued, only a full sort puts them back in place
+    graph->layer_ysort[layer] = ysort;
+    graph->preordered         = false;
+    graph->render_list_dirty  = true;
+}
+
+Node scene_graph_handle_acquire(SceneGraph *graph) {
+    int top = atomic_fetch_sub_explicit(&graph->free_slots_count, 1, memory_order_relaxed) - 1;
+    if (top < 0) {
+        atomic_fetch_add_explicit(&graph->free_slots_count, 1, memory_order_relaxed);
+        return NODE_NULL;
+    }
+
+    return graph->node_handles[graph->free_slots[top]];
+}
+
+void scene_graph_slots_reserve(SceneGraph *graph, int count) {
+    assert(graph != NULL && "Graph cannot be NULL");
+
+    int missing = count - graph->free_slots_count;
+    if (missing > 0) {
+        scene_graph_reserve(graph, graph->capacity + missing);
+    }
+}
+
+void scene_graph_node_insert(SceneGraph *graph, Node node, Node parent) {
     assert(graph != NULL && "Scene graph cannot be NULL");
-    assert(graph->nodes_count < MAX_NODES && "Scene graph overflow");
+    assert(scene_graph_node_valid(graph, node) && "Node handle was not acquired from this graph");
+    assert(graph->node_indices[scene_graph_slot(node)] == NODE_NULL && "Node is already inserted");
+    scene_graph_journal_record(graph, node, SCENE_CHANGE_CREATED);
 
     // If root node just initialize a basic node
     if (parent == NODE_NULL) {
         assert(graph->nodes_count == 0 && "Scene graph root node already exists");
+        assert(node == NODE_ROOT && "The root must be the first node of a graph");
 
-        Node node       = 0;
         graph->nodes[0] = (SceneNode){
-            .id       = node,
-            .userdata = NULL,
+            .parent       = NODE_NULL,
+            .first_child  = NODE_NULL,
+            .last_child   = NODE_NULL,
+            .prev_sibling = NODE_NULL,
+            .next_sibling = NODE_NULL,
         };
 
         scene_graph_index_set(graph, node, 0);
-        scene_graph_sibling_set(graph, node, NODE_NULL);
-        scene_graph_parent_set(graph, node, NODE_NULL);
-        scene_graph_first_child_set(graph, node, NODE_NULL);
+        graph->draw_order[0]                      = scene_graph_slot(node);
+        graph->draw_ranks[scene_graph_slot(node)] = 0;
 
-        graph->nodes_count     = 1;
-        graph->node_next_index = 1;
-        return 0;
-    }
-
-    int index = scene_graph_next_index(graph->node_indices, &graph->node_next_index);
+        graph->local_positions[0] = (Position){0};
+        graph->world_positions[0] = (Position){0};
+        graph->local_rotations[0] = 0.0f;
+        graph->local_scales[0]    = (Scale){1.0f, 1.0f};
+        graph->transform_flags[0] = 0;
+        graph->parent_indices[0]  = NODE_NULL;
+        graph->node_ids[0]        = node;
+        graph->children_counts[0] = 0;
+        graph->nodes_count        = 1;
+        graph->layout_version++;
 
-    if (scene_graph_first_child_get(graph, parent) == NODE_NULL) {
-        scene_graph_first_child_set(graph, parent, index);
-    } else {
-        Node child_node = scene_graph_first_child_get(graph, parent);
-        assert(child_node > 0);
-
-        Node current      = child_node;
-        Node last_sibling = current;
-        while (current != NODE_NULL) {
-            last_sibling = current;
-            current      = scene_graph_sibling_get(graph, current);
-        }
-        scene_graph_sibling_set(graph, last_sibling, index);
+        graph->userdata[scene_graph_slot(node)]           = NULL;
+        graph->previous_positions[scene_graph_slot(node)] = (Position){0};
+        graph->sequences[scene_graph_slot(node)]          = graph->sequence_next++;
+        return;
     }
 
     // Add the new node to the graph
     graph->nodes[graph->nodes_count] = (SceneNode){
-        .id             = index,
-        .parent         = parent,
-        .first_child    = NODE_NULL,
-        .next_sibling   = NODE_NULL,
-        .children_count = 0,
-        .layer          = 0,
+        .parent       = parent,
+        .first_child  = NODE_NULL,
+        .last_child   = NODE_NULL,
+        .prev_sibling = NODE_NULL,
+        .next_sibling = NODE_NULL,
+        .layer        = 0,
     };
 
-    scene_graph_index_set(graph, index, index);
+    // Appending keeps the parent ahead of the child in storage
+    int parent_index                           = scene_graph_index_get(graph, parent);
+    graph->local_positions[graph->nodes_count] = (Position){0};
+    graph->world_positions[graph->nodes_count] = graph->world_positions[parent_index];
+    graph->local_rotations[graph->nodes_count] = 0.0f;
+    graph->local_scales[graph->nodes_count]    = (Scale){1.0f, 1.0f};
+    graph->transform_flags[graph->nodes_count] = 0;
+    graph->parent_indices[graph->nodes_count]  = parent_index;
+    graph->node_ids[graph->nodes_count]        = node;
+    graph->children_counts[graph->nodes_count] = 0;
+    scene_graph_index_set(graph, node, graph->nodes_count);
+
+    // Nothing to interpolate from until the node lived through a tick
+    graph->userdata[scene_graph_slot(node)]           = NULL;
+    graph->previous_positions[scene_graph_slot(node)] = (Position){NAN, NAN};
+    graph->sequences[scene_graph_slot(node)]          = graph->sequence_next++;
+
+    // With no local offset the child sits exactly on its parent, rotation and scale included
+    if (graph->transform_flags[parent_index] & TRANSFORM_WORLD_AFFINE) {
+        graph->transform_flags[graph->nodes_count]  = TRANSFORM_WORLD_AFFINE;
+        graph->world_transforms[graph->nodes_count] = graph->world_transforms[parent_index];
+    }
+
+    // Appending stays a preorder only when the parent sits on the last branch of the tree
+    for (Node ancestor = parent; ancestor != NODE_NULL; ancestor = scene_graph_parent_get(graph, ancestor)) {
+        if (scene_graph_sibling_get(graph, ancestor) != NODE_NULL) {
+            graph->preordered = false;
+            break;
+        }
+    }
+
+    // Drawn last until the next y-sort, NAN never compares equal to its y so that sort places it
+    graph->draw_order[graph->nodes_count]     = scene_graph_slot(node);
+    graph->draw_ranks[scene_graph_slot(node)] = graph->nodes_count;
+    graph->sort_y[scene_graph_slot(node)]     = NAN;
+    scene_graph_sort_queue_slot(graph, scene_graph_slot(node));
 
-    // Track the new node in the updated list
-    scene_graph_node_get(graph, parent)->children_count++;
+    scene_graph_node_link(graph, node, parent);
     graph->nodes_count++;
+    graph->layout_version++;
+}
+
+Node scene_graph_node_new(SceneGraph *graph, Node parent) {
+    assert(graph != NULL && "Scene graph cannot be NULL");
+
+    Node node = scene_graph_handle_new(graph);
+    if (node == NODE_NULL) return NODE_NULL;
+
+    scene_graph_node_insert(graph, node, parent);
+    return node;
+}
+
+// Appends the subtree of the node at index to order in preorder of the sibling links
+static int scene_graph_subtree_gather(SceneGraph *graph, int index, int *order, int count) {
+    const Node top = graph->node_ids[index];
+    Node node      = top;
+    while (true) {
+        order[count++] = scene_graph_index_get(graph, node);
+
+        Node child = scene_graph_first_child_get(graph, node);
+        if (child != NODE_NULL) {
+            node = child;
+            continue;
+        }
+
+        while (node != top && scene_graph_sibling_get(graph, node) == NODE_NULL) {
+            node = scene_graph_parent_get(graph, node);
+        }
+
+        if (node == top) return count;
+        node = scene_graph_sibling_get(graph, node);
+    }
+}
+
+void scene_graph_relayout(SceneGraph *graph) {
+    assert(graph != NULL && "Graph cannot be NULL");
+    if (!graph->relayout) return;
+
+    const int count = graph->nodes_count;
+    int *order      = graph->relayout_order;
+
+    // The dirty flags are clear outside scene_graph_compute_positions, borrow them as marks. A node
+    // stored ahead of its parent is marked, and everything under a marked node with it.
+    uint8_t *marks = graph->dirty_flags;
+    for (int i = 1; i < count; i++) {
+        int parent = graph->parent_indices[i];
+        marks[i]   = parent > i || marks[parent];
+    }
+
+    // Everything else keeps its relative order, every marked subtree follows from its top
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        if (!marks[i]) order[n++] = i;
+    }
+
+    for (int i = 1; i < count; i++) {
+        if (marks[i] && !marks[graph->parent_indices[i]]) {
+            n = scene_graph_subtree_gather(graph, i, order, n);
+        }
+    }
+
+    assert(n == count && "Relayout lost a node");
+    memset(marks, 0, count);
+    scene_graph_storage_permute(graph, order, count);
+    graph->relayout = false;
+}
+
+void scene_graph_node_reparent(SceneGraph *graph, Node node, Node parent) {
+    assert(graph != NULL && "Scene graph cannot be NULL");
+    assert(node != NODE_ROOT && "The root node cannot be reparented");
+
+    for (Node ancestor = parent; ancestor != NODE_NULL; ancestor = scene_graph_parent_get(graph, ancestor)) {
+        assert(ancestor != node && "Cannot reparent a node into its own subtree");
+    }
+
+    if (scene_graph_parent_get(graph, node) == parent) return;
+
+    scene_graph_node_unlink(graph, node);
+    scene_graph_node_link(graph, node, parent);
+    scene_graph_journal_record(graph, node, SCENE_CHANGE_PARENT);
+
+    int index                    = scene_graph_index_get(graph, node);
+    int parent_index             = scene_graph_index_get(graph, parent);
+    graph->parent_indices[index] = parent_index;
+    graph->preordered            = false;
+    graph->render_list_dirty     = true;
+    graph->layout_version++;
 
-    return index;
+    // Only a parent stored after the node breaks the parent-first order, mended before the sweep
+    graph->relayout |= parent_index > index;
+
+    // An empty update marks the node dirty so its subtree is recomputed under the new parent
+    scene_graph_queue_slot(graph, node);
+}
+
+void scene_graph_node_detach(SceneGraph *graph, Node node) {
+    Position position = scene_graph_position_get(graph, node);
+    scene_graph_node_reparent(graph, node, NODE_ROOT);
+
+    // Stay in place unless a position for this frame has already been queued
+    UpdatedSceneNode *update = scene_graph_queue_slot(graph, node);
+    if (!(update->fields & NODE_UPDATE_POSITION)) {
+        scene_graph_position_set(graph, node, position);
+    }
 }
 
 void scene_graph_update(SceneGraph *graph) {
-    for (int i = 0; i < graph->game_objects_count; i++) {
+    const int *offsets = graph->game_object_offsets;
+    graph->updating    = true;
+
+    // Custom objects go one by one through the index, an update may grow and move the array
+    for (int i = offsets[SCENE_GRAPH_KIND_CUSTOM]; i < offsets[SCENE_GRAPH_KIND_CUSTOM + 1]; i++) {
         GameObject *obj = &graph->game_objects[i];
         if (obj->update != NULL) {
             obj->update(graph, obj);
         }
     }
+
+    for (int kind = SCENE_GRAPH_KIND_CUSTOM + 1; kind < graph->update_kinds_count; kind++) {
+        int count = offsets[kind + 1] - offsets[kind];
+        if (count > 0) {
+            graph->update_kinds[kind](graph, offsets[kind], count);
+        }
+    }
+
+    graph->updating = false;
+    while (offsets[SCENE_GRAPH_KINDS] < graph->game_objects_count) {
+        scene_graph_game_object_file(graph);
+    }
 }
 
-void scene_graph_render(SceneGraph *graph) {
+void scene_graph_tick_begin(SceneGraph *graph) {
+    for (int i = 0; i < graph->nodes_count; i++) {
+        graph->previous_positions[scene_graph_slot(graph->node_ids[i])] = graph->world_positions[i];
+    }
+}
+
+static void scene_graph_render_place(SceneGraph *graph, int *cursors, int slot, bool ysort) {
+    if (graph->drawable_indices[slot] == NODE_NULL) return;
+
+    int layer = graph->nodes[graph->node_indices[slot]].layer;
+    if (graph->layer_ysort[layer] != ysort) return;
+
+    int position                 = cursors[layer]++;
+    graph->render_list[position] = slot;
+    graph->render_ranks[slot]    = position;
+}
+
+static int compare_sequence_keys(const void *a, const void *b) {
+    uint64_t ka = *(const uint64_t *)a;
+    uint64_t kb = *(const uint64_t *)b;
+    return (ka > kb) - (ka < kb);
+}
+
+// Counting sort of the drawables by layer, stable over the order each kind of layer is filled in
+static void scene_graph_render_list_update(SceneGraph *graph) {
+    if (!graph->render_list_dirty) return;
+
+    int *offsets = graph->layer_offsets;
+    memset(offsets, 0, sizeof(graph->layer_offsets));
     for (int i = 0; i < graph->drawables_count; i++) {
-        Drawable *obj = &graph->drawables[i];
-        if (obj->draw != NULL) {
-            obj->draw(graph, obj);
+        offsets[scene_graph_layer_get(graph, graph->drawables[i].node) + 1]++;
+    }
+
+    int cursors[SCENE_GRAPH_LAYERS];
+    for (int layer = 0; layer < SCENE_GRAPH_LAYERS; layer++) {
+        offsets[layer + 1] += offsets[layer];
+        cursors[layer]      = offsets[layer];
+    }
+
+    // Y-sorted layers are filled in draw order
+    for (int rank = 0; rank < graph->nodes_count; rank++) {
+        scene_graph_render_place(graph, cursors, graph->draw_order[rank], true);
+    }
+
+    // Static layers in creation order. Storage follows it until a reparent moves a subtree to the
+    // back, so the keys only need sorting after one. The radix scratch is free outside the y-sort.
+    uint64_t *statics = graph->sort_keys;
+    int statics_count = 0;
+    bool ordered      = true;
+    for (int i = 0; i < graph->nodes_count; i++) {
+        int slot = scene_graph_slot(graph->node_ids[i]);
+        if (graph->drawable_indices[slot] == NODE_NULL) continue;
+        if (graph->layer_ysort[graph->nodes[i].layer]) continue;
+
+        uint64_t key = (uint64_t)graph->sequences[slot] << 32 | (uint32_t)slot;
+        ordered &= statics_count == 0 || statics[statics_count - 1] < key;
+        statics[statics_count++] = key;
+    }
+
+    if (!ordered) {
+        qsort(statics, statics_count, sizeof(uint64_t), compare_sequence_keys);
+    }
+
+    for (int i = 0; i < statics_count; i++) {
+        scene_graph_render_place(graph, cursors, (int)(uint32_t)statics[i], false);
+    }
+
+    graph->render_list_dirty = false;
+}
+
+void scene_graph_draw_runs(const Drawable *drawables,
+                           const DrawSource *sources,
+                           const Transform2D *transforms,
+                           int count,
+                           const DrawableDrawBatch *kinds) {
+    int i = 0;
+    while (i < count) {
+        const Drawable *drawable = &drawables[i];
+        if (drawable->kind == SCENE_GRAPH_KIND_CUSTOM) {
+            if (drawable->draw != NULL) {
+                drawable->draw(drawable, &transforms[i]);
+            }
+
+            i++;
+            continue;
+        }
+
+        int end = i + 1;
+        while (end < count && drawables[end].kind == drawable->kind) {
+            end++;
+        }
+
+        kinds[drawable->kind](drawable, &sources[i], &transforms[i], end - i);
+        i = end;
+    }
+}
+
+// Draws the drawables at the given render list positions, every drawable at i when positions is
+// NULL. Custom drawables are drawn in place, runs of a registered kind are gathered into the batch
+// scratch first.
+static void scene_graph_draw_positions(SceneGraph *graph, const int *positions, int count) {
+    int run = 0;
+    for (int i = 0; i <= count; i++) {
+        Drawable *drawable = NULL;
+        if (i < count) {
+            int slot = graph->render_list[positions != NULL ? positions[i] : i];
+            drawable = &graph->drawables[graph->drawable_indices[slot]];
+        }
+
+        if (run > 0 && (drawable == NULL || drawable->kind != graph->draw_batch[0].kind)) {
+            DrawableDrawBatch draw = graph->draw_kinds[graph->draw_batch[0].kind];
+            draw(graph->draw_batch, graph->draw_sources, graph->draw_transforms, run);
+            run = 0;
         }
+
+        if (drawable == NULL) break;
+
+        if (drawable->kind != SCENE_GRAPH_KIND_CUSTOM) {
+            graph->draw_batch[run]      = *drawable;
+            graph->draw_transforms[run] = scene_graph_draw_transform_get(graph, drawable->node);
+            scene_graph_draw_source_capture(graph, drawable, &graph->draw_sources[run++]);
+        } else if (drawable->draw != NULL) {
+            Transform2D transform = scene_graph_draw_transform_get(graph, drawable->node);
+            drawable->draw(drawable, &transform);
+        }
+    }
+}
+
+void scene_graph_render(SceneGraph *graph) {
+    scene_graph_render_list_update(graph);
+    scene_graph_draw_positions(graph, NULL, graph->drawables_count);
+}
+
+static int compare_int(const void *a, const void *b) {
+    int ia = *(const int *)a;
+    int ib = *(const int *)b;
+    return (ia > ib) - (ia < ib);
+}
+
+int scene_graph_cull(SceneGraph *graph, Bounds view) {
+    int *visible = graph->visible_drawables;
+    int count    = spatial_grid_query(graph->grid, view, visible);
+
+    scene_graph_render_list_update(graph);
+
+    // The grid hands back node slots, draw them in render list order so layers and sorting hold
+    for (int i = 0; i < count; i++) {
+        visible[i] = graph->render_ranks[visible[i]];
+    }
+
+    qsort(visible, count, sizeof(int), compare_int);
+    return count;
+}
+
+void scene_graph_render_view(SceneGraph *graph, Bounds view) {
+    int count = scene_graph_cull(graph, view);
+    scene_graph_draw_positions(graph, graph->visible_drawables, count);
+}
+
+static void *scene_graph_grow_array(void *array, int capacity, size_t size) {
+    void *result = realloc(array, capacity * size);
+    assert(result != NULL && "Failed to grow scene graph storage");
+    return result;
+}
+
+static void scene_graph_fill_null(int *array, int from, int to) {
+    for (int i = from; i < to; i++) {
+        array[i] = NODE_NULL;
+    }
+}
+
+bool scene_graph_reserve(SceneGraph *graph, int capacity) {
+    assert(graph != NULL && "Graph cannot be NULL");
+    if (capacity <= graph->capacity) return true;
+    if (graph->capacity == SCENE_GRAPH_MAX_NODES) return false;
+
+    // Round up to whole pages and at least double so repeated growth stays amortized O(1)
+    int pages        = (capacity + SCENE_GRAPH_PAGE_SIZE - 1) / SCENE_GRAPH_PAGE_SIZE;
+    int new_capacity = pages * SCENE_GRAPH_PAGE_SIZE;
+    if (new_capacity < graph->capacity * 2) {
+        new_capacity = graph->capacity * 2;
+    }
+
+    // Slots have to fit the index bits of a handle
+    new_capacity = new_capacity < SCENE_GRAPH_MAX_NODES ? new_capacity : SCENE_GRAPH_MAX_NODES;
+
+    // clang-format off
+    graph->node_indices        = scene_graph_grow_array(graph->node_indices, new_capacity, sizeof(int));
+    graph->node_handles        = scene_graph_grow_array(graph->node_handles, new_capacity, sizeof(Node));
+    graph->free_slots          = scene_graph_grow_array(graph->free_slots, new_capacity, sizeof(int));
+    graph->nodes               = scene_graph_grow_array(graph->nodes, new_capacity, sizeof(SceneNode));
+    graph->updated_nodes       = scene_graph_grow_array(graph->updated_nodes, new_capacity, sizeof(UpdatedSceneNode));
+    graph->update_indices      = scene_graph_grow_array(graph->update_indices, new_capacity, sizeof(int));
+    graph->resolve_chain       = scene_graph_grow_array(graph->resolve_chain, new_capacity, sizeof(int));
+    graph->relayout_order      = scene_graph_grow_array(graph->relayout_order, new_capacity, sizeof(int));
+    graph->relayout_scratch    = scene_graph_grow_array(graph->relayout_scratch, new_capacity, SCENE_GRAPH_PERMUTE_WIDTH);
+    graph->parent_indices      = scene_graph_grow_array(graph->parent_indices, new_capacity, sizeof(int));
+    graph->dirty_flags         = scene_graph_grow_array(graph->dirty_flags, new_capacity, sizeof(uint8_t));
+    graph->node_ids            = scene_graph_grow_array(graph->node_ids, new_capacity, sizeof(Node));
+    graph->children_counts     = scene_graph_grow_array(graph->children_counts, new_capacity, sizeof(int));
+    graph->userdata            = scene_graph_grow_array(graph->userdata, new_capacity, sizeof(void *));
+    graph->local_positions     = scene_graph_grow_array(graph->local_positions, new_capacity, sizeof(Position));
+    graph->world_positions     = scene_graph_grow_array(graph->world_positions, new_capacity, sizeof(Position));
+    graph->previous_positions  = scene_graph_grow_array(graph->previous_positions, new_capacity, sizeof(Position));
+    graph->local_rotations     = scene_graph_grow_array(graph->local_rotations, new_capacity, sizeof(float));
+    graph->local_scales        = scene_graph_grow_array(graph->local_scales, new_capacity, sizeof(Scale));
+    graph->transform_flags     = scene_graph_grow_array(graph->transform_flags, new_capacity, sizeof(uint8_t));
+    graph->world_transforms    = scene_graph_grow_array(graph->world_transforms, new_capacity, sizeof(Transform2D));
+    graph->game_objects        = scene_graph_grow_array(graph->game_objects, new_capacity, sizeof(GameObject));
+    graph->game_object_indices = scene_graph_grow_array(graph->game_object_indices, new_capacity, sizeof(int));
+    graph->drawables           = scene_graph_grow_array(graph->drawables, new_capacity, sizeof(Drawable));
+    graph->drawable_indices    = scene_graph_grow_array(graph->drawable_indices, new_capacity, sizeof(int));
+    graph->journal_indices     = scene_graph_grow_array(graph->journal_indices, new_capacity, sizeof(int));
+    graph->draw_batch          = scene_graph_grow_array(graph->draw_batch, new_capacity, sizeof(Drawable));
+    graph->draw_sources        = scene_graph_grow_array(graph->draw_sources, new_capacity, sizeof(DrawSource));
+    graph->draw_transforms     = scene_graph_grow_array(graph->draw_transforms, new_capacity, sizeof(Transform2D));
+    graph->nodes_to_destroy    = scene_graph_grow_array(graph->nodes_to_destroy, new_capacity, sizeof(int));
+    graph->partition_indices   = scene_graph_grow_array(graph->partition_indices, new_capacity, sizeof(int));
+    graph->partition_tops      = scene_graph_grow_array(graph->partition_tops, new_capacity, sizeof(int));
+    graph->partition_owners    = scene_graph_grow_array(graph->partition_owners, new_capacity, sizeof(int));
+    graph->partition_subtrees  = scene_graph_grow_array(graph->partition_subtrees, new_capacity, sizeof(PartitionSubtree));
+    graph->visible_drawables   = scene_graph_grow_array(graph->visible_drawables, new_capacity, sizeof(int));
+    graph->draw_order          = scene_graph_grow_array(graph->draw_order, new_capacity, sizeof(int));
+    graph->draw_ranks          = scene_graph_grow_array(graph->draw_ranks, new_capacity, sizeof(int));
+    graph->render_list         = scene_graph_grow_array(graph->render_list, new_capacity, sizeof(int));
+    graph->render_ranks        = scene_graph_grow_array(graph->render_ranks, new_capacity, sizeof(int));
+    graph->sequences           = scene_graph_grow_array(graph->sequences, new_capacity, sizeof(uint32_t));
+    graph->sort_queue          = scene_graph_grow_array(graph->sort_queue, new_capacity, sizeof(int));
+    graph->sort_queued         = scene_graph_grow_array(graph->sort_queued, new_capacity, sizeof(uint8_t));
+    graph->sort_y              = scene_graph_grow_array(graph->sort_y, new_capacity, sizeof(float));
+    graph->sort_keys           = scene_graph_grow_array(graph->sort_keys, new_capacity * 2, sizeof(uint64_t));
+    graph->sort_values         = scene_graph_grow_array(graph->sort_values, new_capacity * 2, sizeof(int));
+    graph->sort_offsets        = scene_graph_grow_array(graph->sort_offsets, new_capacity, sizeof(int));
+    graph->sort_parents        = scene_graph_grow_array(graph->sort_parents, new_capacity, sizeof(int));
+    graph->sort_positions      = scene_graph_grow_array(graph->sort_positions, new_capacity, sizeof(int));
+    graph->sort_movers         = scene_graph_grow_array(graph->sort_movers, new_capacity, sizeof(SortMover));
+    graph->sort_spans          = scene_graph_grow_array(graph->sort_spans, new_capacity, sizeof(SortSpan));
+    // clang-format on
+
+    scene_graph_fill_null(graph->node_indices, graph->capacity, new_capacity);
+    scene_graph_fill_null(graph->update_indices, graph->capacity, new_capacity);
+    memset(&graph->dirty_flags[graph->capacity], 0, new_capacity - graph->capacity);
+    memset(&graph->sort_queued[graph->capacity], 0, new_capacity - graph->capacity);
+    scene_graph_fill_null(graph->game_object_indices, graph->capacity, new_capacity);
+    scene_graph_fill_null(graph->drawable_indices, graph->capacity, new_capacity);
+    scene_graph_fill_null(graph->journal_indices, graph->capacity, new_capacity);
+
+    // One entry per slot covers a frame unless slots are reused within it
+    if (graph->journal_capacity < new_capacity) {
+        graph->journal          = scene_graph_grow_array(graph->journal, new_capacity, sizeof(SceneJournalEntry));
+        graph->journal_capacity = new_capacity;
+    }
+
+    // New slots start at generation zero, pushed so the lowest slot is handed out first
+    for (int slot = new_capacity - 1; slot >= graph->capacity; slot--) {
+        graph->node_handles[slot]                    = slot;
+        graph->free_slots[graph->free_slots_count++] = slot;
+    }
+
+    spatial_grid_reserve(graph->grid, new_capacity);
+    graph->capacity = new_capacity;
+    return new_capacity >= capacity;
+}
+
+static void scene_graph_gather(void *array, void *scratch, size_t size, const int *order, int count) {
+    char *src = array;
+    char *dst = scratch;
+    for (int i = 0; i < count; i++) {
+        memcpy(&dst[i * size], &src[order[i] * size], size);
+    }
+
+    memcpy(array, scratch, count * size);
+}
+
+void scene_graph_storage_permute(SceneGraph *graph, const int *order, int count) {
+    assert(graph != NULL && "Graph cannot be NULL");
+    assert(count == graph->nodes_count && "Permutation must cover every node");
+
+    void *scratch = graph->relayout_scratch;
+
+    // clang-format off
+    scene_graph_gather(graph->nodes, scratch, sizeof(SceneNode), order, count);
+    scene_graph_gather(graph->local_positions, scratch, sizeof(Position), order, count);
+    scene_graph_gather(graph->world_positions, scratch, sizeof(Position), order, count);
+    scene_graph_gather(graph->local_rotations, scratch, sizeof(float), order, count);
+    scene_graph_gather(graph->local_scales, scratch, sizeof(Scale), order, count);
+    scene_graph_gather(graph->transform_flags, scratch, sizeof(uint8_t), order, count);
+    scene_graph_gather(graph->world_transforms, scratch, sizeof(Transform2D), order, count);
+    scene_graph_gather(graph->node_ids, scratch, sizeof(Node), order, count);
+    scene_graph_gather(graph->children_counts, scratch, sizeof(int), order, count);
+    // clang-format on
+
+    for (int i = 0; i < count; i++) {
+        scene_graph_index_set(graph, graph->node_ids[i], i);
+    }
+    graph->layout_version++;
+
+    // Every parent must come before its children, refresh their storage indices
+    for (int i = 0; i < count; i++) {
+        Node parent              = graph->nodes[i].parent;
+        graph->parent_indices[i] = parent != NODE_NULL ? scene_graph_index_get(graph, parent) : NODE_NULL;
+        assert(graph->parent_indices[i] < i && "Permutation put a child before its parent");
     }
 }
 
+void scene_graph_free(SceneGraph *graph) {
+    if (graph == NULL) return;
+
+    free(graph->node_indices);
+    free(graph->node_handles);
+    free(graph->free_slots);
+    free(graph->nodes);
+    free(graph->updated_nodes);
+    free(graph->update_indices);
+    free(graph->resolve_chain);
+    free(graph->relayout_order);
+    free(graph->relayout_scratch);
+    free(graph->parent_indices);
+    free(graph->dirty_flags);
+    free(graph->node_ids);
+    free(graph->children_counts);
+    free(graph->userdata);
+    free(graph->local_positions);
+    free(graph->world_positions);
+    free(graph->previous_positions);
+    free(graph->local_rotations);
+    free(graph->local_scales);
+    free(graph->transform_flags);
+    free(graph->world_transforms);
+    free(graph->game_objects);
+    free(graph->game_object_indices);
+    free(graph->drawables);
+    free(graph->drawable_indices);
+    free(graph->journal);
+    free(graph->journal_indices);
+    free(graph->draw_batch);
+    free(graph->draw_sources);
+    free(graph->draw_transforms);
+    free(graph->nodes_to_destroy);
+    free(graph->partition_indices);
+    free(graph->partition_tops);
+    free(graph->partition_owners);
+    free(graph->partition_subtrees);
+    free(graph->visible_drawables);
+    free(graph->draw_order);
+    free(graph->draw_ranks);
+    free(graph->render_list);
+    free(graph->render_ranks);
+    free(graph->sequences);
+    free(graph->sort_queue);
+    free(graph->sort_queued);
+    free(graph->sort_y);
+    free(graph->sort_keys);
+    free(graph->sort_values);
+    free(graph->sort_offsets);
+    free(graph->sort_parents);
+    free(graph->sort_positions);
+    free(graph->sort_movers);
+    free(graph->sort_spans);
+    spatial_grid_free(graph->grid);
+    free(graph);
+}
+
 SceneGraph *scene_graph_new(void) {
     SceneGraph *graph = calloc(sizeof(SceneGraph), 1);
     assert(graph != NULL && "Scene graph cannot be null");
 
-    for (int i = 0; i < MAX_NODES; i++) {
-        scene_graph_index_set(graph, i, NODE_NULL);
-        graph->node_indices[i]        = NODE_NULL;
-        graph->drawable_indices[i]    = NODE_NULL;
-        graph->game_object_indices[i] = NODE_NULL;
-        graph->nodes[i]               = (SceneNode){
-                          .id             = NODE_NULL,
-                          .parent         = NODE_NULL,
-                          .first_child    = NODE_NULL,
-                          .next_sibling   = NODE_NULL,
-                          .children_count = 0,
-                          .layer          = 0,
-        };
+    graph->partition_version  = -1;
+    graph->grid               = spatial_grid_new();
+    graph->preordered         = true;
+    graph->alpha              = 1.0f;
+    graph->update_kinds_count = 1;
+    graph->draw_kinds_count   = 1;
+
+    for (int layer = 0; layer < SCENE_GRAPH_LAYERS; layer++) {
+        graph->layer_ysort[layer] = true;
     }
 
+    // Only the first page is committed up front, the rest is allocated as nodes are added
+    scene_graph_reserve(graph, SCENE_GRAPH_PAGE_SIZE);
     return graph;
 }
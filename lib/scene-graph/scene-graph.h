@@ -2,38 +2,93 @@
 #define LIB_SCENE_GRAPH_NODE_H_
 
 #include <assert.h>
+#include <math.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 
-#define MAX_NODES 32768
+// Storage grows in whole pages so small worlds stay small and large worlds are not capped
+#define SCENE_GRAPH_PAGE_SIZE 256
+
 #define NODE_NULL -1
 #define NODE_ROOT 0
 
+// Handles pack a slot index with a generation that changes every time the slot is freed. The sign
+// bit stays clear so a handle is never NODE_NULL.
+#define NODE_INDEX_BITS      20
+#define NODE_INDEX_MASK      ((1 << NODE_INDEX_BITS) - 1)
+#define NODE_GENERATION_MASK ((1 << (31 - NODE_INDEX_BITS)) - 1)
+#define SCENE_GRAPH_MAX_NODES (1 << NODE_INDEX_BITS)
+
 #define NODE_WORLD 0
 #define NODE_LOCAL 1
 
+#define NODE_UPDATE_POSITION (1 << 0)
+#define NODE_UPDATE_ROTATION (1 << 1)
+#define NODE_UPDATE_SCALE    (1 << 2)
+
+#define TRANSFORM_LOCAL_AFFINE (1 << 0)
+#define TRANSFORM_WORLD_AFFINE (1 << 1)
+
+// Most groups scene_graph_compute_positions_parallel spreads the top-level subtrees over
+#define SCENE_GRAPH_PARTITIONS_MAX 64
+
+// Render layers are drawn in ascending order, every node layer lies in [0, SCENE_GRAPH_LAYERS)
+#define SCENE_GRAPH_LAYERS 16
+
+// Kind 0 calls every game object or drawable through its own function pointer, the kinds
+// registered after it are run as one batch over all objects of the kind
+#define SCENE_GRAPH_KIND_CUSTOM 0
+#define SCENE_GRAPH_KINDS       8
+
 typedef int Node;
 
 typedef struct SceneGraph SceneGraph;
 
+typedef struct SpatialGrid SpatialGrid;
+
 typedef struct Position {
     float x;
     float y;
 } Position;
 
+typedef struct Scale {
+    float x;
+    float y;
+} Scale;
+
+typedef struct Bounds {
+    float x;
+    float y;
+    float width;
+    float height;
+} Bounds;
+
+// 2x3 affine matrix, maps (x, y) to (a * x + c * y + tx, b * x + d * y + ty)
+typedef struct Transform2D {
+    float a;
+    float b;
+    float c;
+    float d;
+    float tx;
+    float ty;
+} Transform2D;
+
+// Links and layer, everything the sort and tree walks touch. The handle, child count and userdata
+// of a node live in their own arrays so these passes do not drag them through cache.
 typedef struct SceneNode {
-    int id;
     int parent;
     int first_child;
+    int last_child;
+    int prev_sibling;
     int next_sibling;
-    int children_count;
     int layer;
-    void* userdata;
 } SceneNode;
 
 typedef struct GameObject {
     Node node;
+    int kind;
     void (*update)(SceneGraph* graph, struct GameObject* object);
     void (*destroy)(SceneGraph* graph, struct GameObject* object);
     void* data;
@@ -41,98 +96,413 @@ typedef struct GameObject {
 
 typedef struct Drawable {
     Node node;
-    void (*draw)(SceneGraph* graph, struct Drawable* renderable);
+    int kind;
+    void (*draw)(const struct Drawable* renderable, const Transform2D* transform);
     void (*destroy)(SceneGraph* graph, struct Drawable* renderable);
     void* data;
+    Bounds bounds;  // relative to the node, culled against the view once mapped to world space
 } Drawable;
 
+// Updates the game objects in [first, first + count), all of one kind. Read them through
+// graph->game_objects, the array moves when the graph grows. Objects created meanwhile are only
+// filed under their kind after the pass and are first updated next frame.
+typedef void (*GameObjectUpdateBatch)(SceneGraph* graph, int first, int count);
+
+// What a batch draws for one drawable, captured on the thread that owns the graph so a draw never
+// reads the data the drawable points to
+typedef struct DrawSource {
+    int texture;
+    Bounds source;  // region of the texture, in texels
+    float texture_width;
+    float texture_height;
+} DrawSource;
+
+// Captures the source of a drawable of one kind, whatever its data holds right now
+typedef void (*DrawableCapture)(const Drawable* drawable, DrawSource* source);
+
+// Draws a run of drawables of one kind that follow each other in draw order, with the sources
+// captured for them
+typedef void (*DrawableDrawBatch)(const Drawable* drawables,
+                                  const DrawSource* sources,
+                                  const Transform2D* transforms,
+                                  int count);
+
+// What happened to a node, a journal entry ORs together everything that did within one frame
+typedef enum SceneChange {
+    SCENE_CHANGE_CREATED   = 1 << 0,
+    SCENE_CHANGE_DESTROYED = 1 << 1,
+    SCENE_CHANGE_MOVED     = 1 << 2,  // world position or transform
+    SCENE_CHANGE_LAYER     = 1 << 3,
+    SCENE_CHANGE_PARENT    = 1 << 4,
+} SceneChange;
+
+typedef struct SceneJournalEntry {
+    Node node;
+    int changes;
+} SceneJournalEntry;
+
 typedef struct __attribute__((aligned(16))) UpdatedSceneNode {
     Node node;
     int type;
     float x;
     float y;
+    int fields;
+    float rotation;
+    float scale_x;
+    float scale_y;
 } UpdatedSceneNode;
 
+// A child of the root with the number of nodes under it, what the parallel sweep balances
+typedef struct PartitionSubtree {
+    int top;
+    int size;
+} PartitionSubtree;
+
+// A queued node taken out of its sibling list by the incremental y-sort, with the closest sibling
+// in front of it that stays put and its draw rank before the repair
+typedef struct SortMover {
+    Node node;
+    Node hint;
+    int rank;
+} SortMover;
+
+// Draw order range of the children of one parent whose order changed this frame. While movers are
+// reinserted end is the rank of the last child touched, then one past the end of its subtree.
+typedef struct SortSpan {
+    int parent;
+    int first;
+    int end;
+} SortSpan;
+
 typedef struct SceneGraph {
+    // NOTE: Number of slots every array below can hold, always a multiple of the page size
+    int capacity;
+
     // NOTE: Local & World Transforms
+    // nodes, parent_indices and the positions share one storage order where every parent comes
+    // before its children, so world positions are a single forward sweep. A reparent under a node
+    // stored later only flags the relayout, all of them are put right in one pass before the next
+    // sweep, through persistent scratch.
     int nodes_count;
-    int node_indices[MAX_NODES];
-    int node_next_index;
-    SceneNode nodes[MAX_NODES];
-    UpdatedSceneNode updated_nodes[MAX_NODES];
+    int* node_indices;
+    Node* node_handles;
+    int* free_slots;
+    atomic_int free_slots_count;
+    SceneNode* nodes;
+    int* parent_indices;
+    uint8_t* dirty_flags;
+    bool relayout;
+    int* relayout_order;
+    void* relayout_scratch;
+
+    // NOTE: Cold Node Data
+    // Handles and child counts follow storage order, userdata is keyed by slot and never moves
+    Node* node_ids;
+    int* children_counts;
+    void** userdata;
+
+    // NOTE: Pending position writes, at most one per node (last write wins)
+    UpdatedSceneNode* updated_nodes;
+    int* update_indices;
     int updated_nodes_count;
-
-    Position local_positions[MAX_NODES];
-    Position world_positions[MAX_NODES];
+    UpdatedSceneNode update_sink;
+    int* resolve_chain;  // ancestors of a world write, leaf first, walked back to resolve its parent
+
+    Position* local_positions;
+    Position* world_positions;
+
+    // NOTE: Interpolation
+    // World positions as of the last scene_graph_tick_begin, keyed by slot so storage moves leave
+    // them alone, and NAN for nodes added since. Draws lerp from them to the world positions by
+    // alpha, the fraction of a tick the render is past the last one.
+    Position* previous_positions;
+    float alpha;
+
+    // NOTE: Rotation & Scale
+    // Only nodes flagged TRANSFORM_WORLD_AFFINE hold a world transform, every other node is a
+    // plain translation by its world position. While no node is rotated or scaled the graph stays
+    // on the translation kernel and the world transforms are never touched.
+    float* local_rotations;
+    Scale* local_scales;
+    uint8_t* transform_flags;
+    Transform2D* world_transforms;
+    int affine_count;
+    bool affine;
+
+    // NOTE: Subtree Partition
+    // Storage indices grouped per parallel chunk, each group ascending so parents still come first.
+    // Rebuilt whenever layout_version has moved on since it was built, or the chunk count changed.
+    int layout_version;
+    int partition_version;
+    int partition_count;
+    int* partition_indices;
+    int partition_offsets[SCENE_GRAPH_PARTITIONS_MAX + 1];
+
+    // Partition scratch, the top-level subtree of every node and the node count or job of each top
+    int* partition_tops;
+    int* partition_owners;
+    PartitionSubtree* partition_subtrees;
 
     // NOTE: Game Objects
-    GameObject game_objects[MAX_NODES];
-    int game_object_indices[MAX_NODES];
+    // Packed by kind, kind k in [game_object_offsets[k], game_object_offsets[k + 1]). Objects
+    // created while scene_graph_update runs wait unfiled past the last kind until it is done.
+    GameObject* game_objects;
+    int* game_object_indices;
     int game_objects_count;
+    int game_object_offsets[SCENE_GRAPH_KINDS + 1];
+    GameObjectUpdateBatch update_kinds[SCENE_GRAPH_KINDS];
+    int update_kinds_count;
+    bool updating;
 
     // NOTE: Drawables
-    Drawable drawables[MAX_NODES];
-    int drawable_indices[MAX_NODES];
+    // Drawables keep no order of their own, render gathers them in draw order into the batch
+    // scratch and hands every run of one kind to its batch at once
+    Drawable* drawables;
+    int* drawable_indices;
     int drawables_count;
+    DrawableDrawBatch draw_kinds[SCENE_GRAPH_KINDS];
+    DrawableCapture draw_captures[SCENE_GRAPH_KINDS];
+    int draw_kinds_count;
+    Drawable* draw_batch;
+    DrawSource* draw_sources;
+    Transform2D* draw_transforms;
+
+    // NOTE: Visibility
+    // World bounds of every drawable, keyed by node slot and refreshed from the dirty flags
+    SpatialGrid* grid;
+    int* visible_drawables;
+
+    // NOTE: Draw Order
+    // Node slots in the preorder walk of the sorted sibling lists, the order render draws in. The
+    // y-sort only rewrites this list, storage keeps the parent-first layout the sweeps rely on.
+    int* draw_order;
+    int* draw_ranks;  // position of every slot in draw_order
+
+    // NOTE: Render Layers
+    // Drawable slots bucketed by layer with a counting sort, rebuilt before drawing once the draw
+    // order, a layer or the drawables changed. Y-sorted layers keep the draw order inside their
+    // bucket, static layers keep creation order, which a reparent moving storage around leaves be.
+    // Their nodes are never queued for the y-sort and sort among siblings by creation as well.
+    bool layer_ysort[SCENE_GRAPH_LAYERS];
+    int layer_offsets[SCENE_GRAPH_LAYERS + 1];
+    int* render_list;
+    int* render_ranks;  // position of every drawable slot in render_list
+    bool render_list_dirty;
+    uint32_t* sequences;  // creation order of every slot, handed out on insert
+    uint32_t sequence_next;
+
+    // NOTE: Sorting
+    // Slots whose y or layer changed since the last y-sort, repaired in place by the next one
+    int* sort_queue;
+    int sort_queue_count;
+    uint8_t* sort_queued;
+    float* sort_y;
+    bool preordered;  // draw_order is exactly the preorder walk of the sibling lists
+
+    // Radix sort scratch, kept across frames. Keys and values (storage indices) hold two halves of
+    // capacity entries that the passes ping-pong between, the children of a node at its offset.
+    uint64_t* sort_keys;
+    int* sort_values;
+    int* sort_offsets;
+    int* sort_parents;
+    int* sort_positions;
+
+    // Incremental y-sort scratch, as many movers and spans as the sort queue holds slots
+    SortMover* sort_movers;
+    SortSpan* sort_spans;
 
     // NOTE: Destruction Queue
-    int nodes_to_destroy[MAX_NODES];
+    int* nodes_to_destroy;
     int nodes_to_destroy_count;
+
+    // NOTE: Change Journal
+    // One entry per node that changed since the last scene_graph_journal_clear, in the order the
+    // nodes first changed. journal_indices maps a slot to its entry so repeated changes merge, an
+    // index past journal_count is left over from an earlier frame. A slot reused within the frame
+    // gets a second entry, the only way the journal can outgrow the capacity.
+    SceneJournalEntry* journal;
+    int* journal_indices;
+    int journal_count;
+    int journal_capacity;
 } SceneGraph;
 
 Drawable* scene_graph_drawable_new(SceneGraph* graph, Node node);
 
 GameObject* scene_graph_game_object_new(SceneGraph* graph, Node node);
 
+// Kinds are numbered from 1 in registration order, which is also the order their updates run in
+int scene_graph_update_kind_register(SceneGraph* graph, GameObjectUpdateBatch update);
+
+// Capture may be NULL for kinds that draw from the drawable alone, their sources are left zeroed
+int scene_graph_draw_kind_register(SceneGraph* graph,
+                                   DrawableDrawBatch draw,
+                                   DrawableCapture capture);
+
+// Game object updated by the batch of a registered kind instead of its update pointer
+GameObject* scene_graph_game_object_new_kind(SceneGraph* graph, Node node, int kind);
+
+Drawable* scene_graph_drawable_new_kind(SceneGraph* graph, Node node, int kind);
+
+// Captures the source of a drawable through its kind, zeroed for the custom kind
+void scene_graph_draw_source_capture(const SceneGraph* graph,
+                                     const Drawable* drawable,
+                                     DrawSource* source);
+
+/**
+ * Draws drawables in the given order, one call per drawable of the custom kind and one batch
+ * call per run of a registered kind.
+ *
+ * @param sources Sources captured for the drawables, read by the batches only
+ * @param kinds Draw batches by kind, index 0 unused
+ */
+void scene_graph_draw_runs(const Drawable* drawables,
+                           const DrawSource* sources,
+                           const Transform2D* transforms,
+                           int count,
+                           const DrawableDrawBatch* kinds);
+
+// Returns NODE_NULL once the graph holds SCENE_GRAPH_MAX_NODES nodes
 Node scene_graph_node_new(SceneGraph* graph, Node parent);
 
+// Pops a free slot without locking, safe from any thread while the graph is otherwise left alone.
+// Returns NODE_NULL when no slot is free, see scene_graph_slots_reserve.
+Node scene_graph_handle_acquire(SceneGraph* graph);
+
+// Hands a slot back, either once its node is removed or for an acquired handle never inserted.
+// The handle goes stale. Only on the thread that owns the graph.
+void scene_graph_handle_free(SceneGraph* graph, Node node);
+
+// Makes sure at least count slots can be acquired without growing the storage, or as many as are
+// left below SCENE_GRAPH_MAX_NODES
+void scene_graph_slots_reserve(SceneGraph* graph, int count);
+
+// Inserts a node under a handle from scene_graph_handle_acquire
+void scene_graph_node_insert(SceneGraph* graph, Node node, Node parent);
+
+// Moves a node and its subtree under a new parent, keeping its local transform. Relinking is O(1),
+// a parent stored after the node leaves storage to scene_graph_relayout, one O(N) pass however
+// many reparents there were. Any reparent makes the next y-sort a full one.
+void scene_graph_node_reparent(SceneGraph* graph, Node node, Node parent);
+
+// Restores the parent-first storage order reparents broke, subtrees that have to follow their new
+// parent are moved to the back and the rest keeps its order. A no-op unless a reparent flagged it,
+// called by scene_graph_apply_updates and scene_graph_remove_destroyed_nodes.
+void scene_graph_relayout(SceneGraph* graph);
+
+// Moves a node and its subtree under the root, keeping its world position
+void scene_graph_node_detach(SceneGraph* graph, Node node);
+
 void scene_graph_remove_destroyed_nodes(SceneGraph* graph);
 
 void scene_graph_compute_positions(SceneGraph* graph);
 
+// Applies every queued write and returns the lowest storage index left dirty
+int scene_graph_apply_updates(SceneGraph* graph);
+
+// Propagates dirty transforms over ascending storage indices, the dirty flags are left set
+void scene_graph_sweep_indices(SceneGraph* graph, const int* indices, int count);
+
 void scene_graph_update(SceneGraph* graph);
 
+// Keeps the world positions of the tick that just ended for draws to interpolate from
+void scene_graph_tick_begin(SceneGraph* graph);
+
 void scene_graph_render(SceneGraph* graph);
 
+// Draws only the drawables whose world bounds intersect the view, in the same order as render
+void scene_graph_render_view(SceneGraph* graph, Bounds view);
+
+// Render list positions of the drawables whose world bounds intersect the view, ascending, written
+// to visible_drawables. Returns how many there are.
+int scene_graph_cull(SceneGraph* graph, Bounds view);
+
+void scene_graph_drawable_bounds_set(SceneGraph* graph, Node node, Bounds bounds);
+
+// Static layers draw in the order their nodes were added and cost nothing in the y-sort, every
+// layer starts out y-sorted
+void scene_graph_layer_ysort_set(SceneGraph* graph, int layer, bool ysort);
+
+// Ends a sweep that started at first, refreshes moved drawables, queues nodes whose y changed
+// for the next y-sort and clears the dirty flags
+void scene_graph_sweep_finish(SceneGraph* graph, int first);
+
+// Marks a node for the next y-sort, its sort key changed without its world position changing
+void scene_graph_sort_queue(SceneGraph* graph, Node node);
+
+// Adds changes to the journal entry of the node for this frame
+void scene_graph_journal_record(SceneGraph* graph, Node node, int changes);
+
+// Grows every array to hold at least capacity slots, or as many as handles can address. Returns
+// false when capacity is past SCENE_GRAPH_MAX_NODES.
+bool scene_graph_reserve(SceneGraph* graph, int capacity);
+
+// Reorders node storage so order[i] (an old storage index) becomes index i, parents first
+void scene_graph_storage_permute(SceneGraph* graph, const int* order, int count);
+
+void scene_graph_free(SceneGraph* graph);
+
 SceneGraph* scene_graph_new(void);
 
+static inline int scene_graph_slot(Node node) {
+    return node & NODE_INDEX_MASK;
+}
+
+static inline bool scene_graph_node_valid(const SceneGraph* graph, Node node) {
+    int slot = scene_graph_slot(node);
+    return node >= 0 && slot < graph->capacity && graph->node_handles[slot] == node;
+}
+
 static inline int scene_graph_index_get(const SceneGraph* graph, Node node) {
-    assert(node >= 0 && node < MAX_NODES && "Node is out of bounds");
-    return graph->node_indices[node];
+    int slot = scene_graph_slot(node);
+    assert(node >= 0 && slot < graph->capacity && "Node is out of bounds");
+
+    // A stale handle reads as destroyed instead of aliasing whatever reuses its slot
+    return graph->node_handles[slot] == node ? graph->node_indices[slot] : NODE_NULL;
 }
 
 static inline void scene_graph_index_set(SceneGraph* graph, Node node, int index) {
-    assert(node >= 0 && node < MAX_NODES && "Node is out of bounds");
-    graph->node_indices[node] = index;
+    int slot = scene_graph_slot(node);
+    assert(node >= 0 && slot < graph->capacity && "Node is out of bounds");
+    graph->node_indices[slot] = index;
 }
 
 static inline int scene_graph_node_child_count(const SceneGraph* graph, Node node) {
     int index = scene_graph_index_get(graph, node);
-    return graph->nodes[index].children_count;
+    assert(index != NODE_NULL && "Node is not in the graph");
+    return graph->children_counts[index];
 }
 
 static inline void* scene_graph_userdata_get(SceneGraph* graph, Node node) {
-    int index = scene_graph_index_get(graph, node);
-    return graph->nodes[index].userdata;
+    assert(scene_graph_index_get(graph, node) != NODE_NULL && "Node is not in the graph");
+    return graph->userdata[scene_graph_slot(node)];
 }
 
 static inline void scene_graph_userdata_set(SceneGraph* graph, Node node, void* userdata) {
-    int index                    = scene_graph_index_get(graph, node);
-    graph->nodes[index].userdata = userdata;
+    assert(scene_graph_index_get(graph, node) != NODE_NULL && "Node is not in the graph");
+    graph->userdata[scene_graph_slot(node)] = userdata;
 }
 
+// Returns the layer, or NODE_NULL when the handle is stale and nothing was written
 static inline int scene_graph_layer_set(SceneGraph* graph, Node node, int layer) {
-    int index                        = scene_graph_index_get(graph, node);
+    assert(layer >= 0 && layer < SCENE_GRAPH_LAYERS && "Layer is out of range");
+    int index = scene_graph_index_get(graph, node);
+    if (index == NODE_NULL) return NODE_NULL;
+
+    scene_graph_sort_queue(graph, node);
+    scene_graph_journal_record(graph, node, SCENE_CHANGE_LAYER);
+    graph->render_list_dirty = true;
     return graph->nodes[index].layer = layer;
 }
 
 static inline int scene_graph_layer_get(const SceneGraph* graph, Node node) {
     int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
     return graph->nodes[index].layer;
 }
 
 static inline SceneNode* scene_graph_node_get(SceneGraph* graph, Node node) {
     int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
     return &graph->nodes[index];
 }
 
@@ -142,12 +512,16 @@ static inline Node scene_graph_sibling_get(const SceneGraph* graph, Node node) {
 }
 
 static inline void scene_graph_sibling_set(SceneGraph* graph, Node node, Node child) {
-    int index                        = scene_graph_index_get(graph, node);
+    int index = scene_graph_index_get(graph, node);
+    if (index == NODE_NULL) return;
+
     graph->nodes[index].next_sibling = child;
 }
 
 static inline void scene_graph_first_child_set(SceneGraph* graph, Node node, Node child) {
-    int index                       = scene_graph_index_get(graph, node);
+    int index = scene_graph_index_get(graph, node);
+    if (index == NODE_NULL) return;
+
     graph->nodes[index].first_child = child;
 }
 
@@ -156,46 +530,145 @@ static inline Node scene_graph_first_child_get(const SceneGraph* graph, Node nod
     return index != -1 ? graph->nodes[index].first_child : -1;
 }
 
+static inline Node scene_graph_last_child_get(const SceneGraph* graph, Node node) {
+    int index = scene_graph_index_get(graph, node);
+    return index != -1 ? graph->nodes[index].last_child : -1;
+}
+
+static inline Node scene_graph_prev_sibling_get(const SceneGraph* graph, Node node) {
+    int index = scene_graph_index_get(graph, node);
+    return index != -1 ? graph->nodes[index].prev_sibling : -1;
+}
+
 static inline Node scene_graph_parent_get(SceneGraph* graph, Node node) {
     int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
     return graph->nodes[index].parent;
 }
 
 static inline void scene_graph_parent_set(SceneGraph* graph, Node node, Node parent) {
-    int index                  = scene_graph_index_get(graph, node);
+    int index = scene_graph_index_get(graph, node);
+    if (index == NODE_NULL) return;
+
     graph->nodes[index].parent = parent;
 }
 
+// Queues the node and its whole subtree, everything queued is removed in one pass by
+// scene_graph_remove_destroyed_nodes
 static inline void scene_graph_node_destroy(SceneGraph* graph, Node node) {
+    assert(graph->nodes_to_destroy_count < graph->capacity && "Destruction queue overflow");
     graph->nodes_to_destroy[graph->nodes_to_destroy_count++] = node;
 }
 
 static inline Position scene_graph_position_get(SceneGraph* graph, Node node) {
     int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
     return graph->world_positions[index];
 }
 
 static inline Position scene_graph_local_position_get(SceneGraph* graph, Node node) {
     int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
     return graph->local_positions[index];
 }
 
+static inline UpdatedSceneNode* scene_graph_queue_slot(SceneGraph* graph, Node node) {
+    int slot = scene_graph_slot(node);
+    assert(node >= 0 && slot < graph->capacity && "Node is out of bounds");
+
+    // Writes through a stale handle land in a sink that is never applied
+    if (graph->node_handles[slot] != node) {
+        return &graph->update_sink;
+    }
+
+    // Coalesce repeated writes to the same node so the queue can never outgrow the node storage
+    int entry = graph->update_indices[slot];
+    if (entry == NODE_NULL) {
+        assert(graph->updated_nodes_count < graph->capacity && "Update queue overflow");
+        entry                       = graph->updated_nodes_count++;
+        graph->update_indices[slot] = entry;
+        graph->updated_nodes[entry] = (UpdatedSceneNode){.node = node};
+    }
+
+    return &graph->updated_nodes[entry];
+}
+
+static inline void scene_graph_queue_update(SceneGraph* graph, Node node, Position position, int type) {
+    UpdatedSceneNode* update = scene_graph_queue_slot(graph, node);
+    update->fields          |= NODE_UPDATE_POSITION;
+    update->type             = type;
+    update->x                = position.x;
+    update->y                = position.y;
+}
+
 static inline void scene_graph_local_position_set(SceneGraph* graph, Node node, Position position) {
-    graph->updated_nodes[graph->updated_nodes_count++] = (UpdatedSceneNode){
-        .node = node,
-        .x    = position.x,
-        .y    = position.y,
-        .type = NODE_LOCAL,
-    };
+    scene_graph_queue_update(graph, node, position, NODE_LOCAL);
 }
 
+// Moves the node to a world position, mapped into its parent's space when positions are computed.
+// Under a parent scaled to zero no local position reaches it, the write then lands as a plain
+// offset from the parent and takes effect once the parent is scaled back up.
 static inline void scene_graph_position_set(SceneGraph* graph, Node node, Position position) {
-    graph->updated_nodes[graph->updated_nodes_count++] = (UpdatedSceneNode){
-        .node = node,
-        .x    = position.x,
-        .y    = position.y,
-        .type = NODE_WORLD,
-    };
+    scene_graph_queue_update(graph, node, position, NODE_WORLD);
+}
+
+static inline void scene_graph_rotation_set(SceneGraph* graph, Node node, float radians) {
+    UpdatedSceneNode* update = scene_graph_queue_slot(graph, node);
+    update->fields          |= NODE_UPDATE_ROTATION;
+    update->rotation         = radians;
+}
+
+static inline void scene_graph_scale_set(SceneGraph* graph, Node node, Scale scale) {
+    UpdatedSceneNode* update = scene_graph_queue_slot(graph, node);
+    update->fields          |= NODE_UPDATE_SCALE;
+    update->scale_x          = scale.x;
+    update->scale_y          = scale.y;
+}
+
+static inline float scene_graph_rotation_get(const SceneGraph* graph, Node node) {
+    int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
+    return graph->local_rotations[index];
+}
+
+static inline Scale scene_graph_scale_get(const SceneGraph* graph, Node node) {
+    int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
+    return graph->local_scales[index];
+}
+
+static inline Transform2D scene_graph_transform_get(const SceneGraph* graph, Node node) {
+    int index = scene_graph_index_get(graph, node);
+    assert(index != NODE_NULL && "Node is not in the graph");
+    if (graph->affine && (graph->transform_flags[index] & TRANSFORM_WORLD_AFFINE)) {
+        return graph->world_transforms[index];
+    }
+
+    Position position = graph->world_positions[index];
+    return (Transform2D){.a = 1.0f, .d = 1.0f, .tx = position.x, .ty = position.y};
+}
+
+// Starts the next frame of the journal, consumers read journal[0, journal_count) before this
+static inline void scene_graph_journal_clear(SceneGraph* graph) {
+    graph->journal_count = 0;
+}
+
+static inline void scene_graph_alpha_set(SceneGraph* graph, float alpha) {
+    assert(alpha >= 0.0f && alpha <= 1.0f && "Alpha must lie in [0, 1]");
+    graph->alpha = alpha;
+}
+
+// World transform to draw a node with, its translation interpolated from the previous tick
+static inline Transform2D scene_graph_draw_transform_get(const SceneGraph* graph, Node node) {
+    Transform2D transform = scene_graph_transform_get(graph, node);
+    if (graph->alpha >= 1.0f) return transform;
+
+    Position previous = graph->previous_positions[scene_graph_slot(node)];
+    if (isnan(previous.x)) return transform;
+
+    transform.tx = previous.x + (transform.tx - previous.x) * graph->alpha;
+    transform.ty = previous.y + (transform.ty - previous.y) * graph->alpha;
+    return transform;
 }
 
 #endif  // LIB_SCENE_GRAPH_NODE_H_
@@ -0,0 +1,302 @@
+#include "snapshot.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scene-graph/scene-graph.h"
+#include "scene-graph/spatial-grid.h"
+
+#define SNAPSHOT_SECTIONS (26 + SPATIAL_GRID_STATE_ARRAYS)
+
+typedef struct SnapshotHeader {
+    int capacity;
+    int nodes_count;
+    int free_slots_count;
+    int affine_count;
+    int game_objects_count;
+    int drawables_count;
+    int sort_queue_count;
+    float alpha;
+    bool affine;
+    bool preordered;
+    bool layer_ysort[SCENE_GRAPH_LAYERS];
+    int game_object_offsets[SCENE_GRAPH_KINDS + 1];
+} SnapshotHeader;
+
+typedef struct SnapshotSection {
+    void* data;
+    size_t size;
+} SnapshotSection;
+
+// Streams the layout into a snapshot, a delta compares it block by block against the base
+typedef struct SnapshotWriter {
+    SceneSnapshot* snapshot;
+    const SceneSnapshot* base;
+    size_t offset;
+    size_t fill;
+    char block[SCENE_SNAPSHOT_BLOCK];
+} SnapshotWriter;
+
+// Streams the layout back out of a full snapshot, or out of a delta laid over its base
+typedef struct SnapshotReader {
+    const SceneSnapshot* snapshot;
+    const SceneSnapshot* base;
+    size_t offset;
+    int block;
+} SnapshotReader;
+
+// Every array of the layout in order, the ones indexed by slot or storage index hold count entries
+static int snapshot_sections(SceneGraph* graph, SnapshotHeader* header, int count, SnapshotSection* sections) {
+    int n = 0;
+
+    // clang-format off
+    sections[n++] = (SnapshotSection){header, sizeof(*header)};
+    sections[n++] = (SnapshotSection){graph->node_indices, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->node_handles, sizeof(Node) * count};
+    sections[n++] = (SnapshotSection){graph->free_slots, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->nodes, sizeof(SceneNode) * count};
+    sections[n++] = (SnapshotSection){graph->parent_indices, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->node_ids, sizeof(Node) * count};
+    sections[n++] = (SnapshotSection){graph->children_counts, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->userdata, sizeof(void*) * count};
+    sections[n++] = (SnapshotSection){graph->local_positions, sizeof(Position) * count};
+    sections[n++] = (SnapshotSection){graph->world_positions, sizeof(Position) * count};
+    sections[n++] = (SnapshotSection){graph->previous_positions, sizeof(Position) * count};
+    sections[n++] = (SnapshotSection){graph->local_rotations, sizeof(float) * count};
+    sections[n++] = (SnapshotSection){graph->local_scales, sizeof(Scale) * count};
+    sections[n++] = (SnapshotSection){graph->transform_flags, sizeof(uint8_t) * count};
+    sections[n++] = (SnapshotSection){graph->world_transforms, sizeof(Transform2D) * count};
+    sections[n++] = (SnapshotSection){graph->game_objects, sizeof(GameObject) * count};
+    sections[n++] = (SnapshotSection){graph->game_object_indices, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->drawables, sizeof(Drawable) * count};
+    sections[n++] = (SnapshotSection){graph->drawable_indices, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->draw_order, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->draw_ranks, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->sort_queue, sizeof(int) * count};
+    sections[n++] = (SnapshotSection){graph->sort_queued, sizeof(uint8_t) * count};
+    sections[n++] = (SnapshotSection){graph->sort_y, sizeof(float) * count};
+    // clang-format on
+
+    void* arrays[SPATIAL_GRID_STATE_ARRAYS];
+    size_t sizes[SPATIAL_GRID_STATE_ARRAYS];
+    spatial_grid_state(graph->grid, count, arrays, sizes);
+    for (int i = 0; i < SPATIAL_GRID_STATE_ARRAYS; i++) {
+        sections[n++] = (SnapshotSection){arrays[i], sizes[i]};
+    }
+
+    assert(n <= SNAPSHOT_SECTIONS && "Snapshot sections overflow");
+    return n;
+}
+
+static void snapshot_reserve(SceneSnapshot* snapshot, size_t size) {
+    if (size <= snapshot->data_capacity) return;
+
+    size_t capacity = snapshot->data_capacity * 2 > size ? snapshot->data_capacity * 2 : size;
+    snapshot->data  = realloc(snapshot->data, capacity);
+    assert(snapshot->data != NULL && "Failed to grow snapshot");
+    snapshot->data_capacity = capacity;
+}
+
+static void snapshot_flush(SnapshotWriter* writer) {
+    SceneSnapshot* snapshot = writer->snapshot;
+    size_t start            = writer->offset - writer->fill;
+    if (writer->fill == 0 || memcmp(writer->block, &writer->base->data[start], writer->fill) == 0) {
+        writer->fill = 0;
+        return;
+    }
+
+    if (snapshot->blocks_count == snapshot->blocks_capacity) {
+        snapshot->blocks_capacity = snapshot->blocks_capacity > 0 ? snapshot->blocks_capacity * 2 : 64;
+        snapshot->blocks          = realloc(snapshot->blocks, sizeof(int) * snapshot->blocks_capacity);
+        assert(snapshot->blocks != NULL && "Failed to grow snapshot blocks");
+    }
+
+    snapshot_reserve(snapshot, (size_t)(snapshot->blocks_count + 1) * SCENE_SNAPSHOT_BLOCK);
+    memcpy(&snapshot->data[(size_t)snapshot->blocks_count * SCENE_SNAPSHOT_BLOCK], writer->block, writer->fill);
+    snapshot->blocks[snapshot->blocks_count++] = (int)(start / SCENE_SNAPSHOT_BLOCK);
+    writer->fill                               = 0;
+}
+
+static void snapshot_write(SnapshotWriter* writer, const char* bytes, size_t size) {
+    if (writer->base == NULL) {
+        memcpy(&writer->snapshot->data[writer->offset], bytes, size);
+        writer->offset += size;
+        return;
+    }
+
+    while (size > 0) {
+        size_t n = SCENE_SNAPSHOT_BLOCK - writer->fill;
+        n        = n < size ? n : size;
+        memcpy(&writer->block[writer->fill], bytes, n);
+        writer->fill   += n;
+        writer->offset += n;
+        bytes          += n;
+        size           -= n;
+
+        if (writer->fill == SCENE_SNAPSHOT_BLOCK) {
+            snapshot_flush(writer);
+        }
+    }
+}
+
+static void snapshot_read(SnapshotReader* reader, char* bytes, size_t size) {
+    const SceneSnapshot* snapshot = reader->snapshot;
+    if (!snapshot->delta) {
+        memcpy(bytes, &snapshot->data[reader->offset], size);
+        reader->offset += size;
+        return;
+    }
+
+    // Blocks are visited in order, the changed ones come from the delta and the rest from the base
+    while (size > 0) {
+        int block    = (int)(reader->offset / SCENE_SNAPSHOT_BLOCK);
+        size_t first = reader->offset % SCENE_SNAPSHOT_BLOCK;
+        size_t n     = SCENE_SNAPSHOT_BLOCK - first;
+        n            = n < size ? n : size;
+
+        while (reader->block < snapshot->blocks_count && snapshot->blocks[reader->block] < block) {
+            reader->block++;
+        }
+
+        const char* source = &reader->base->data[reader->offset];
+        if (reader->block < snapshot->blocks_count && snapshot->blocks[reader->block] == block) {
+            source = &snapshot->data[(size_t)reader->block * SCENE_SNAPSHOT_BLOCK + first];
+        }
+
+        memcpy(bytes, source, n);
+        reader->offset += n;
+        bytes          += n;
+        size           -= n;
+    }
+}
+
+void scene_graph_snapshot(SceneGraph* graph, SceneSnapshot* snapshot, const SceneSnapshot* base) {
+    assert(graph != NULL && "Graph cannot be NULL");
+    assert(snapshot != NULL && snapshot != base && "Snapshot cannot be NULL or its own base");
+
+    // Cleared first so padding compares equal between two captures
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.capacity           = graph->capacity;
+    header.nodes_count        = graph->nodes_count;
+    header.free_slots_count   = graph->free_slots_count;
+    header.affine_count       = graph->affine_count;
+    header.game_objects_count = graph->game_objects_count;
+    header.drawables_count    = graph->drawables_count;
+    header.sort_queue_count   = graph->sort_queue_count;
+    header.alpha              = graph->alpha;
+    header.affine             = graph->affine;
+    header.preordered         = graph->preordered;
+    memcpy(header.layer_ysort, graph->layer_ysort, sizeof(header.layer_ysort));
+    memcpy(header.game_object_offsets, graph->game_object_offsets, sizeof(header.game_object_offsets));
+
+    SnapshotSection sections[SNAPSHOT_SECTIONS];
+    int count   = snapshot_sections(graph, &header, graph->capacity, sections);
+    size_t size = 0;
+    for (int s = 0; s < count; s++) {
+        size += sections[s].size;
+    }
+
+    // The layout only lines up with a full base of the same capacity
+    if (base != NULL && (base->delta || base->size != size)) {
+        base = NULL;
+    }
+
+    snapshot->capacity     = graph->capacity;
+    snapshot->size         = size;
+    snapshot->delta        = base != NULL;
+    snapshot->blocks_count = 0;
+    if (base == NULL) {
+        snapshot_reserve(snapshot, size);
+    }
+
+    SnapshotWriter writer = {.snapshot = snapshot, .base = base};
+    for (int s = 0; s < count; s++) {
+        snapshot_write(&writer, sections[s].data, sections[s].size);
+    }
+
+    if (base != NULL) {
+        snapshot_flush(&writer);
+    }
+}
+
+void scene_graph_restore(SceneGraph* graph, const SceneSnapshot* snapshot, const SceneSnapshot* base) {
+    assert(graph != NULL && snapshot != NULL && "Graph and snapshot cannot be NULL");
+    assert((!snapshot->delta || (base != NULL && !base->delta && base->size == snapshot->size)) &&
+           "A delta needs the full snapshot it was taken against");
+
+    SnapshotHeader header;
+    SnapshotReader reader = {.snapshot = snapshot, .base = base};
+    snapshot_read(&reader, (char*)&header, sizeof(header));
+
+    // Pending writes and destructions belong to the timeline that is thrown away
+    for (int i = 0; i < graph->updated_nodes_count; i++) {
+        graph->update_indices[scene_graph_slot(graph->updated_nodes[i].node)] = NODE_NULL;
+    }
+
+    graph->updated_nodes_count    = 0;
+    graph->nodes_to_destroy_count = 0;
+    memset(graph->dirty_flags, 0, graph->nodes_count);
+
+    scene_graph_reserve(graph, header.capacity);
+
+    // Slots the graph grew by since did not exist back then, nodes living in them go stale
+    const int grown = graph->capacity - header.capacity;
+    for (int slot = header.capacity; slot < graph->capacity; slot++) {
+        if (graph->node_indices[slot] != NODE_NULL) {
+            int generation            = ((graph->node_handles[slot] >> NODE_INDEX_BITS) + 1) & NODE_GENERATION_MASK;
+            graph->node_handles[slot] = (generation << NODE_INDEX_BITS) | slot;
+        }
+
+        graph->node_indices[slot]        = NODE_NULL;
+        graph->game_object_indices[slot] = NODE_NULL;
+        graph->drawable_indices[slot]    = NODE_NULL;
+        graph->sort_queued[slot]         = 0;
+    }
+
+    spatial_grid_forget(graph->grid, header.capacity);
+
+    SnapshotSection sections[SNAPSHOT_SECTIONS];
+    int count = snapshot_sections(graph, &header, header.capacity, sections);
+    for (int s = 1; s < count; s++) {
+        snapshot_read(&reader, sections[s].data, sections[s].size);
+    }
+
+    // Grown slots go under the restored free slots, where growing again would have put them
+    if (grown > 0) {
+        memmove(&graph->free_slots[grown], graph->free_slots, sizeof(int) * header.free_slots_count);
+        for (int i = 0; i < grown; i++) {
+            graph->free_slots[i] = graph->capacity - 1 - i;
+        }
+    }
+
+    graph->nodes_count        = header.nodes_count;
+    graph->free_slots_count   = header.free_slots_count + grown;
+    graph->affine_count       = header.affine_count;
+    graph->game_objects_count = header.game_objects_count;
+    graph->drawables_count    = header.drawables_count;
+    graph->sort_queue_count   = header.sort_queue_count;
+    graph->alpha              = header.alpha;
+    graph->affine             = header.affine;
+    graph->preordered         = header.preordered;
+    graph->render_list_dirty  = true;
+    graph->layout_version++;
+    memcpy(graph->layer_ysort, header.layer_ysort, sizeof(header.layer_ysort));
+    memcpy(graph->game_object_offsets, header.game_object_offsets, sizeof(header.game_object_offsets));
+}
+
+void scene_snapshot_free(SceneSnapshot* snapshot) {
+    if (snapshot == NULL) return;
+
+    free(snapshot->data);
+    free(snapshot->blocks);
+    free(snapshot);
+}
+
+SceneSnapshot* scene_snapshot_new(void) {
+    SceneSnapshot* snapshot = calloc(1, sizeof(SceneSnapshot));
+    assert(snapshot != NULL && "Snapshot cannot be NULL");
+    return snapshot;
+}
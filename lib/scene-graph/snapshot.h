@@ -0,0 +1,58 @@
+#ifndef LIB_SCENE_GRAPH_SNAPSHOT_H_
+#define LIB_SCENE_GRAPH_SNAPSHOT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct SceneGraph SceneGraph;
+
+// Deltas keep whole blocks of this many bytes wherever they differ from their base
+#define SCENE_SNAPSHOT_BLOCK 512
+
+// Node, transform, layer, draw order and component index state of a graph, back to back in one
+// buffer whose layout only depends on the capacity of the graph
+typedef struct SceneSnapshot {
+    int capacity;
+    size_t size;  // bytes of the full layout
+    bool delta;
+
+    // The full layout, or for a delta only the blocks that changed, back to back
+    char* data;
+    size_t data_capacity;
+
+    // Block index of every block a delta holds, ascending
+    int* blocks;
+    int blocks_count;
+    int blocks_capacity;
+} SceneSnapshot;
+
+SceneSnapshot* scene_snapshot_new(void);
+
+void scene_snapshot_free(SceneSnapshot* snapshot);
+
+/**
+ * Captures the graph between frames, pending position writes and destructions are not part of it.
+ * Taken against a base only the blocks that differ from it are kept, which is what makes keeping
+ * several frames around for rewinding cheap. A base taken at another capacity gives a full one.
+ *
+ * @param graph Scene graph
+ * @param snapshot Receives the state, its buffers are reused from the last capture
+ * @param base Full snapshot to take a delta against, NULL for a full snapshot
+ */
+void scene_graph_snapshot(SceneGraph* graph, SceneSnapshot* snapshot, const SceneSnapshot* base);
+
+/**
+ * Puts the graph back the way it was, which is one copy per array. Pending writes and
+ * destructions are dropped. Slots are handed out again in the same order as after the capture,
+ * so handles taken since then have to be dropped with the rest of that timeline.
+ *
+ * Components are restored as they were, data pointers included. Whatever they point to has to
+ * outlive every snapshot that still holds them.
+ *
+ * @param graph Scene graph the snapshot was taken from
+ * @param snapshot Full snapshot or delta
+ * @param base The snapshot a delta was taken against, unused for a full snapshot
+ */
+void scene_graph_restore(SceneGraph* graph, const SceneSnapshot* snapshot, const SceneSnapshot* base);
+
+#endif  // LIB_SCENE_GRAPH_SNAPSHOT_H_
@@ -0,0 +1,188 @@
+#include "spatial-grid.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "scene-graph/scene-graph.h"
+
+// Home of the entries larger than a cell, past the hashed buckets
+#define SPATIAL_GRID_OVERSIZED SPATIAL_GRID_BUCKETS
+
+typedef struct SpatialGrid {
+    int capacity;
+
+    // NOTE: Buckets hold doubly linked lists of entries so moving one never walks a list. The last
+    // one holds the entries larger than a cell, any other entry that intersects a view starts at
+    // most one cell left and up of it.
+    int buckets[SPATIAL_GRID_BUCKETS + 1];
+    int bucket_stamps[SPATIAL_GRID_BUCKETS + 1];
+    int stamp;
+
+    int* homes;
+    int* next;
+    int* prev;
+    Bounds* bounds;
+} SpatialGrid;
+
+static int spatial_grid_cell(float coordinate) {
+    return (int)floorf(coordinate / SPATIAL_GRID_CELL_SIZE);
+}
+
+static int spatial_grid_bucket(int cx, int cy) {
+    uint32_t hash = (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u;
+    return hash & (SPATIAL_GRID_BUCKETS - 1);
+}
+
+static int spatial_grid_home(Bounds bounds) {
+    if (bounds.width > SPATIAL_GRID_CELL_SIZE || bounds.height > SPATIAL_GRID_CELL_SIZE) {
+        return SPATIAL_GRID_OVERSIZED;
+    }
+
+    return spatial_grid_bucket(spatial_grid_cell(bounds.x), spatial_grid_cell(bounds.y));
+}
+
+static void spatial_grid_unlink(SpatialGrid* grid, int id) {
+    int home = grid->homes[id];
+    if (grid->prev[id] == NODE_NULL) {
+        grid->buckets[home] = grid->next[id];
+    } else {
+        grid->next[grid->prev[id]] = grid->next[id];
+    }
+
+    if (grid->next[id] != NODE_NULL) {
+        grid->prev[grid->next[id]] = grid->prev[id];
+    }
+
+    grid->homes[id] = NODE_NULL;
+}
+
+void spatial_grid_update(SpatialGrid* grid, int id, Bounds bounds) {
+    assert(id >= 0 && id < grid->capacity && "Entry is out of bounds");
+
+    int home         = spatial_grid_home(bounds);
+    grid->bounds[id] = bounds;
+
+    if (grid->homes[id] == home) return;
+    if (grid->homes[id] != NODE_NULL) {
+        spatial_grid_unlink(grid, id);
+    }
+
+    grid->homes[id]     = home;
+    grid->prev[id]      = NODE_NULL;
+    grid->next[id]      = grid->buckets[home];
+    grid->buckets[home] = id;
+    if (grid->next[id] != NODE_NULL) {
+        grid->prev[grid->next[id]] = id;
+    }
+}
+
+void spatial_grid_remove(SpatialGrid* grid, int id) {
+    assert(id >= 0 && id < grid->capacity && "Entry is out of bounds");
+    if (grid->homes[id] != NODE_NULL) {
+        spatial_grid_unlink(grid, id);
+    }
+}
+
+static int spatial_grid_collect(SpatialGrid* grid, int bucket, Bounds view, int* results, int count) {
+    // Several cells can hash to one bucket, visit each bucket once per query
+    if (grid->bucket_stamps[bucket] == grid->stamp) return count;
+    grid->bucket_stamps[bucket] = grid->stamp;
+
+    for (int id = grid->buckets[bucket]; id != NODE_NULL; id = grid->next[id]) {
+        Bounds b = grid->bounds[id];
+        if (b.x <= view.x + view.width && b.x + b.width >= view.x && b.y <= view.y + view.height &&
+            b.y + b.height >= view.y) {
+            results[count++] = id;
+        }
+    }
+
+    return count;
+}
+
+int spatial_grid_query(SpatialGrid* grid, Bounds view, int* results) {
+    assert(grid != NULL && "Grid cannot be NULL");
+
+    int x0    = spatial_grid_cell(view.x - SPATIAL_GRID_CELL_SIZE);
+    int y0    = spatial_grid_cell(view.y - SPATIAL_GRID_CELL_SIZE);
+    int x1    = spatial_grid_cell(view.x + view.width);
+    int y1    = spatial_grid_cell(view.y + view.height);
+    int count = 0;
+    grid->stamp++;
+
+    count = spatial_grid_collect(grid, SPATIAL_GRID_OVERSIZED, view, results, count);
+
+    // A view larger than the bucket table is cheaper to answer by visiting every bucket once
+    if ((int64_t)(x1 - x0 + 1) * (y1 - y0 + 1) >= SPATIAL_GRID_BUCKETS) {
+        for (int bucket = 0; bucket < SPATIAL_GRID_BUCKETS; bucket++) {
+            count = spatial_grid_collect(grid, bucket, view, results, count);
+        }
+        return count;
+    }
+
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            count = spatial_grid_collect(grid, spatial_grid_bucket(cx, cy), view, results, count);
+        }
+    }
+
+    return count;
+}
+
+void spatial_grid_state(SpatialGrid* grid, int count, void** arrays, size_t* sizes) {
+    assert(count <= grid->capacity && "Entries are out of bounds");
+
+    // clang-format off
+    arrays[0] = grid->buckets;      sizes[0] = sizeof(grid->buckets);
+    arrays[1] = grid->homes;        sizes[1] = sizeof(int) * count;
+    arrays[2] = grid->next;         sizes[2] = sizeof(int) * count;
+    arrays[3] = grid->prev;         sizes[3] = sizeof(int) * count;
+    arrays[4] = grid->bounds;       sizes[4] = sizeof(Bounds) * count;
+    // clang-format on
+}
+
+void spatial_grid_forget(SpatialGrid* grid, int first) {
+    for (int i = first; i < grid->capacity; i++) {
+        grid->homes[i] = NODE_NULL;
+    }
+}
+
+void spatial_grid_reserve(SpatialGrid* grid, int capacity) {
+    assert(grid != NULL && "Grid cannot be NULL");
+    if (capacity <= grid->capacity) return;
+
+    grid->homes  = realloc(grid->homes, sizeof(int) * capacity);
+    grid->next   = realloc(grid->next, sizeof(int) * capacity);
+    grid->prev   = realloc(grid->prev, sizeof(int) * capacity);
+    grid->bounds = realloc(grid->bounds, sizeof(Bounds) * capacity);
+    assert(grid->homes != NULL && grid->next != NULL && grid->prev != NULL && grid->bounds != NULL &&
+           "Failed to grow spatial grid");
+
+    for (int i = grid->capacity; i < capacity; i++) {
+        grid->homes[i] = NODE_NULL;
+    }
+
+    grid->capacity = capacity;
+}
+
+void spatial_grid_free(SpatialGrid* grid) {
+    if (grid == NULL) return;
+
+    free(grid->homes);
+    free(grid->next);
+    free(grid->prev);
+    free(grid->bounds);
+    free(grid);
+}
+
+SpatialGrid* spatial_grid_new(void) {
+    SpatialGrid* grid = calloc(1, sizeof(SpatialGrid));
+    assert(grid != NULL && "Grid cannot be NULL");
+
+    for (int i = 0; i <= SPATIAL_GRID_BUCKETS; i++) {
+        grid->buckets[i] = NODE_NULL;
+    }
+
+    return grid;
+}
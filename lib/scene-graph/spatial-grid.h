@@ -0,0 +1,63 @@
+#ifndef LIB_SCENE_GRAPH_SPATIAL_GRID_H_
+#define LIB_SCENE_GRAPH_SPATIAL_GRID_H_
+
+#include <stddef.h>
+
+#ifndef SPATIAL_GRID_CELL_SIZE
+#define SPATIAL_GRID_CELL_SIZE 128.0f
+#endif
+
+// Cells are hashed into a fixed number of buckets, so the world itself is unbounded
+#define SPATIAL_GRID_BUCKETS 4096
+
+// Number of raw arrays handed out by spatial_grid_state
+#define SPATIAL_GRID_STATE_ARRAYS 5
+
+typedef struct Bounds Bounds;
+
+typedef struct SpatialGrid SpatialGrid;
+
+/**
+ * Inserts an entry or moves it to its new bounds. Entries live in the cell of their top-left
+ * corner, which keeps a move at O(1) no matter how large the bounds are. Entries larger than a
+ * cell live in one list of their own that every query tests.
+ *
+ * @param grid Spatial grid
+ * @param id Entry id, below the reserved capacity
+ * @param bounds World space bounds of the entry
+ */
+void spatial_grid_update(SpatialGrid* grid, int id, Bounds bounds);
+
+void spatial_grid_remove(SpatialGrid* grid, int id);
+
+/**
+ * Collects every entry whose bounds intersect the view, in no particular order
+ *
+ * @param grid Spatial grid
+ * @param view World space rectangle to test against
+ * @param results Receives the entry ids, must hold as many ids as the reserved capacity
+ * @return Number of ids written to results
+ */
+int spatial_grid_query(SpatialGrid* grid, Bounds view, int* results);
+
+/**
+ * Raw arrays holding the grid and its first count entries, snapshots copy them as they are. The
+ * query stamps are left out, they only have to differ from the next stamp.
+ *
+ * @param grid Spatial grid
+ * @param count Number of entries covered, at most the reserved capacity
+ * @param arrays Receives SPATIAL_GRID_STATE_ARRAYS pointers
+ * @param sizes Receives the size in bytes of every array
+ */
+void spatial_grid_state(SpatialGrid* grid, int count, void** arrays, size_t* sizes);
+
+// Drops every entry from first on without unlinking it, for lists restored from before they existed
+void spatial_grid_forget(SpatialGrid* grid, int first);
+
+void spatial_grid_reserve(SpatialGrid* grid, int capacity);
+
+void spatial_grid_free(SpatialGrid* grid);
+
+SpatialGrid* spatial_grid_new(void);
+
+#endif  // LIB_SCENE_GRAPH_SPATIAL_GRID_H_
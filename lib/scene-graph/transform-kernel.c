@@ -0,0 +1,126 @@
+#include "transform-kernel.h"
+
+#include <stdbool.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "scene-graph/scene-graph.h"
+
+#define KERNEL_BATCH 4
+
+// A batch is safe to compute in one go when none of its nodes is the parent of another
+static inline bool batch_independent(const int* parents, int i) {
+    return parents[i + 1] < i && parents[i + 2] < i && parents[i + 3] < i;
+}
+
+static inline void node_compute(Position* world, const Position* local, const int* parents, int i) {
+    world[i].x = world[parents[i]].x + local[i].x;
+    world[i].y = world[parents[i]].y + local[i].y;
+}
+
+static inline void batch_compute(Position* world,
+                                 const Position* local,
+                                 const int* parents,
+                                 int i) {
+#if defined(__AVX2__)
+    // Pairwise 64-bit loads beat vgatherdpd for four scattered parents on the CPUs we measured
+    __m128 lo = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&world[parents[i + 0]]);
+    __m128 hi = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&world[parents[i + 2]]);
+    lo        = _mm_loadh_pi(lo, (const __m64*)&world[parents[i + 1]]);
+    hi        = _mm_loadh_pi(hi, (const __m64*)&world[parents[i + 3]]);
+    __m256 pw = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    __m256 lp = _mm256_loadu_ps((const float*)&local[i]);
+    _mm256_storeu_ps((float*)&world[i], _mm256_add_ps(pw, lp));
+#elif defined(__SSE2__)
+    __m128 lo = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&world[parents[i + 0]]);
+    __m128 hi = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)&world[parents[i + 2]]);
+    lo        = _mm_loadh_pi(lo, (const __m64*)&world[parents[i + 1]]);
+    hi        = _mm_loadh_pi(hi, (const __m64*)&world[parents[i + 3]]);
+    _mm_storeu_ps((float*)&world[i + 0], _mm_add_ps(lo, _mm_loadu_ps((const float*)&local[i + 0])));
+    _mm_storeu_ps((float*)&world[i + 2], _mm_add_ps(hi, _mm_loadu_ps((const float*)&local[i + 2])));
+#elif defined(__ARM_NEON)
+    float32x2_t p0 = vld1_f32((const float*)&world[parents[i + 0]]);
+    float32x2_t p1 = vld1_f32((const float*)&world[parents[i + 1]]);
+    float32x2_t p2 = vld1_f32((const float*)&world[parents[i + 2]]);
+    float32x2_t p3 = vld1_f32((const float*)&world[parents[i + 3]]);
+    float32x4_t lo = vaddq_f32(vcombine_f32(p0, p1), vld1q_f32((const float*)&local[i + 0]));
+    float32x4_t hi = vaddq_f32(vcombine_f32(p2, p3), vld1q_f32((const float*)&local[i + 2]));
+    vst1q_f32((float*)&world[i + 0], lo);
+    vst1q_f32((float*)&world[i + 2], hi);
+#else
+    for (int j = i; j < i + KERNEL_BATCH; j++) {
+        node_compute(world, local, parents, j);
+    }
+#endif
+}
+
+void scene_graph_transform_kernel(Position* world,
+                                  const Position* local,
+                                  const int* parents,
+                                  int begin,
+                                  int end) {
+    int i = begin;
+    for (; i + KERNEL_BATCH <= end; i += KERNEL_BATCH) {
+        if (batch_independent(parents, i)) {
+            batch_compute(world, local, parents, i);
+        } else {
+            for (int j = i; j < i + KERNEL_BATCH; j++) {
+                node_compute(world, local, parents, j);
+            }
+        }
+    }
+
+    for (; i < end; i++) {
+        node_compute(world, local, parents, i);
+    }
+}
+
+static inline void node_compute_dirty(Position* world,
+                                      const Position* local,
+                                      const int* parents,
+                                      uint8_t* dirty,
+                                      int i) {
+    if (dirty[i] | dirty[parents[i]]) {
+        dirty[i] = 1;
+        node_compute(world, local, parents, i);
+    }
+}
+
+void scene_graph_transform_kernel_dirty(Position* world,
+                                        const Position* local,
+                                        const int* parents,
+                                        uint8_t* dirty,
+                                        int begin,
+                                        int end) {
+    int i = begin;
+    for (; i + KERNEL_BATCH <= end; i += KERNEL_BATCH) {
+        if (!batch_independent(parents, i)) {
+            for (int j = i; j < i + KERNEL_BATCH; j++) {
+                node_compute_dirty(world, local, parents, dirty, j);
+            }
+            continue;
+        }
+
+        uint8_t d0 = dirty[i + 0] | dirty[parents[i + 0]];
+        uint8_t d1 = dirty[i + 1] | dirty[parents[i + 1]];
+        uint8_t d2 = dirty[i + 2] | dirty[parents[i + 2]];
+        uint8_t d3 = dirty[i + 3] | dirty[parents[i + 3]];
+        if ((d0 | d1 | d2 | d3) == 0) continue;
+
+        dirty[i + 0] = d0;
+        dirty[i + 1] = d1;
+        dirty[i + 2] = d2;
+        dirty[i + 3] = d3;
+
+        // Clean nodes in the batch recompute to exactly the value they already hold
+        batch_compute(world, local, parents, i);
+    }
+
+    for (; i < end; i++) {
+        node_compute_dirty(world, local, parents, dirty, i);
+    }
+}
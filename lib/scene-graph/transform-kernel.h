@@ -0,0 +1,34 @@
+#ifndef LIB_SCENE_GRAPH_TRANSFORM_KERNEL_H_
+#define LIB_SCENE_GRAPH_TRANSFORM_KERNEL_H_
+
+#include <stdint.h>
+
+typedef struct Position Position;
+
+/**
+ * Computes world[i] = world[parents[i]] + local[i] for every i in [begin, end)
+ *
+ * @param world World positions, read for parents and written for [begin, end)
+ * @param local Local positions
+ * @param parents Storage index of every node's parent, always lower than the node's own index
+ * @param begin First index to compute, must be past the root
+ * @param end One past the last index to compute
+ */
+void scene_graph_transform_kernel(Position* world,
+                                  const Position* local,
+                                  const int* parents,
+                                  int begin,
+                                  int end);
+
+/**
+ * Same as scene_graph_transform_kernel, but only batches holding a dirty node or a node with a
+ * dirty parent are computed. Dirty flags are propagated from parents to children as it goes.
+ */
+void scene_graph_transform_kernel_dirty(Position* world,
+                                        const Position* local,
+                                        const int* parents,
+                                        uint8_t* dirty,
+                                        int begin,
+                                        int end);
+
+#endif  // LIB_SCENE_GRAPH_TRANSFORM_KERNEL_H_
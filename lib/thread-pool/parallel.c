@@ -0,0 +1,114 @@
+#include "parallel.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct ParallelLoop {
+    ParallelForFunction function;
+    void* context;
+    int begin;
+    int count;
+    int chunks;
+} ParallelLoop;
+
+typedef struct ParallelChunk {
+    const ParallelLoop* loop;
+    int chunk;
+} ParallelChunk;
+
+typedef struct ParallelReduce {
+    ParallelReduceFunction reduce;
+    void* context;
+    unsigned char* partials;
+    size_t size;
+} ParallelReduce;
+
+int parallel_chunks(const ThreadPool* pool, int count, int grain) {
+    assert(grain > 0 && "Grain must be positive");
+    if (pool == NULL || count <= grain) return 1;
+
+    int chunks = pool->workers_count + 1;
+    chunks     = chunks < count / grain ? chunks : count / grain;
+    return chunks < PARALLEL_MAX_CHUNKS ? chunks : PARALLEL_MAX_CHUNKS;
+}
+
+static void parallel_chunk_job(void* arg) {
+    const ParallelChunk* chunk = arg;
+    const ParallelLoop* loop   = chunk->loop;
+
+    int begin = loop->begin + (int)((int64_t)loop->count * chunk->chunk / loop->chunks);
+    int end   = loop->begin + (int)((int64_t)loop->count * (chunk->chunk + 1) / loop->chunks);
+    loop->function(loop->context, chunk->chunk, begin, end);
+}
+
+void parallel_for(ThreadPool* pool,
+                  int begin,
+                  int end,
+                  int grain,
+                  ParallelForFunction function,
+                  void* context) {
+    assert(function != NULL && "Loop function cannot be NULL");
+    if (end <= begin) return;
+
+    int chunks = parallel_chunks(pool, end - begin, grain);
+    if (chunks == 1) {
+        function(context, 0, begin, end);
+        return;
+    }
+
+    ParallelLoop loop = {function, context, begin, end - begin, chunks};
+    ParallelChunk jobs[PARALLEL_MAX_CHUNKS];
+    JobCounter counter = {0};
+
+    // The caller takes the first chunk rather than sitting in the wait while the others start
+    for (int c = chunks - 1; c >= 0; c--) {
+        jobs[c] = (ParallelChunk){&loop, c};
+        if (c > 0) {
+            thread_pool_run(pool, parallel_chunk_job, &jobs[c], &counter);
+        }
+    }
+
+    parallel_chunk_job(&jobs[0]);
+    thread_pool_wait(pool, &counter);
+}
+
+static void parallel_reduce_chunk(void* context, int chunk, int begin, int end) {
+    ParallelReduce* reduce = context;
+    reduce->reduce(reduce->context, begin, end, reduce->partials + chunk * reduce->size);
+}
+
+void parallel_reduce(ThreadPool* pool,
+                     int begin,
+                     int end,
+                     int grain,
+                     void* result,
+                     size_t size,
+                     ParallelReduceFunction reduce,
+                     ParallelCombineFunction combine,
+                     void* context) {
+    assert(reduce != NULL && combine != NULL && "Reduce functions cannot be NULL");
+    if (end <= begin) return;
+
+    int chunks = parallel_chunks(pool, end - begin, grain);
+    if (chunks == 1) {
+        reduce(context, begin, end, result);
+        return;
+    }
+
+    unsigned char* partials = malloc(size * chunks);
+    assert(partials != NULL && "Failed to allocate partial results");
+    for (int c = 0; c < chunks; c++) {
+        memcpy(partials + c * size, result, size);
+    }
+
+    ParallelReduce state = {reduce, context, partials, size};
+    parallel_for(pool, begin, end, grain, parallel_reduce_chunk, &state);
+
+    for (int c = 0; c < chunks; c++) {
+        combine(context, result, partials + c * size);
+    }
+
+    free(partials);
+}
@@ -0,0 +1,60 @@
+#ifndef LIB_THREAD_POOL_PARALLEL_H_
+#define LIB_THREAD_POOL_PARALLEL_H_
+
+#include <stddef.h>
+
+#include "thread-pool/thread-pool.h"
+
+// Most chunks one loop is cut into, however many workers the pool has
+#define PARALLEL_MAX_CHUNKS 64
+
+// Runs one chunk, [begin, end) of the loop's range. Chunks are numbered from 0 in range order.
+typedef void (*ParallelForFunction)(void* context, int chunk, int begin, int end);
+
+// Folds [begin, end) into partial, which starts out as a copy of the identity
+typedef void (*ParallelReduceFunction)(void* context, int begin, int end, void* partial);
+
+// Folds one chunk's partial into the result, called for every chunk in range order
+typedef void (*ParallelCombineFunction)(void* context, void* result, const void* partial);
+
+/**
+ * Chunks a loop over count indices is cut into, one per worker and the caller, each holding at
+ * least grain indices. The same pool, count and grain always give the same chunks.
+ *
+ * @param pool Thread pool, NULL keeps the whole range in one chunk
+ */
+int parallel_chunks(const ThreadPool* pool, int count, int grain);
+
+/**
+ * Runs function over [begin, end) cut into parallel_chunks chunks and returns once all of them
+ * are done. The caller runs a chunk itself, a range of a single chunk never reaches the pool.
+ *
+ * @param pool Thread pool, NULL runs the whole range on the calling thread
+ * @param grain Fewest indices worth a chunk of their own
+ */
+void parallel_for(ThreadPool* pool,
+                  int begin,
+                  int end,
+                  int grain,
+                  ParallelForFunction function,
+                  void* context);
+
+/**
+ * Reduces [begin, end) chunk by chunk and combines the partials into result in range order, so
+ * the same chunks give the same result even for operations that do not associate, like float sums.
+ *
+ * @param result Identity of the reduction on the way in, 0 for a sum, every partial starts as a
+ * copy of it
+ * @param size Size of the result in bytes
+ */
+void parallel_reduce(ThreadPool* pool,
+                     int begin,
+                     int end,
+                     int grain,
+                     void* result,
+                     size_t size,
+                     ParallelReduceFunction reduce,
+                     ParallelCombineFunction combine,
+                     void* context);
+
+#endif  // LIB_THREAD_POOL_PARALLEL_H_
@@ -0,0 +1,225 @@
+#include "task-graph.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+TaskGraph* task_graph_new(ThreadPool* pool) {
+    assert(pool != NULL && "Thread pool cannot be NULL");
+
+    TaskGraph* graph = calloc(1, sizeof(TaskGraph));
+    assert(graph != NULL && "Task graph cannot be NULL");
+    graph->pool = pool;
+    return graph;
+}
+
+void task_graph_free(TaskGraph* graph) {
+    if (graph == NULL) return;
+
+    free(graph->successors);
+    free(graph);
+}
+
+void task_graph_clear(TaskGraph* graph) {
+    graph->tasks_count = 0;
+    graph->compiled    = false;
+}
+
+int task_graph_add(TaskGraph* graph, const char* name, JobFunction function, void* argument) {
+    assert(function != NULL && "Task function cannot be NULL");
+    assert(graph->tasks_count < TASK_GRAPH_MAX_TASKS && "Too many tasks");
+
+    int index  = graph->tasks_count++;
+    Task* task = &graph->tasks[index];
+
+    // Accesses start out empty, they are declared on the returned index
+    *task = (Task){
+        .graph    = graph,
+        .index    = index,
+        .function = function,
+        .argument = argument,
+    };
+
+    graph->compiled = false;
+
+    snprintf(task->name, sizeof(task->name), "%s", name != NULL ? name : "task");
+    return index;
+}
+
+static void task_graph_access(TaskGraph* graph, int task, const void* resource, bool write) {
+    assert(task >= 0 && task < graph->tasks_count && "Task does not exist");
+    assert(resource != NULL && "Resource cannot be NULL");
+
+    Task* t         = &graph->tasks[task];
+    graph->compiled = false;
+    for (int i = 0; i < t->accesses_count; i++) {
+        if (t->accesses[i].resource == resource) {
+            t->accesses[i].write |= write;
+            return;
+        }
+    }
+
+    assert(t->accesses_count < TASK_GRAPH_MAX_ACCESSES && "Too many accesses for one task");
+    t->accesses[t->accesses_count++] = (TaskAccess){resource, write};
+}
+
+void task_graph_read(TaskGraph* graph, int task, const void* resource) {
+    task_graph_access(graph, task, resource, false);
+}
+
+void task_graph_write(TaskGraph* graph, int task, const void* resource) {
+    task_graph_access(graph, task, resource, true);
+}
+
+// 0 when the task leaves the resource alone, 1 when it reads it and 2 when it writes it
+static int task_touches(const Task* task, const void* resource) {
+    for (int i = 0; i < task->accesses_count; i++) {
+        if (task->accesses[i].resource == resource) return task->accesses[i].write ? 2 : 1;
+    }
+
+    return 0;
+}
+
+// Direct predecessors of task j, deduplicated through the stamps
+static int task_graph_predecessors(const TaskGraph* graph, int j, int* stamps, int* out) {
+    const Task* task = &graph->tasks[j];
+    int count        = 0;
+
+    for (int a = 0; a < task->accesses_count; a++) {
+        TaskAccess access = task->accesses[a];
+
+        // Back to the last writer, collecting the readers on the way when this is a write
+        for (int i = j - 1; i >= 0; i--) {
+            int touch = task_touches(&graph->tasks[i], access.resource);
+            if (touch == 0 || (touch == 1 && !access.write)) continue;
+
+            if (stamps[i] != j) {
+                stamps[i]    = j;
+                out[count++] = i;
+            }
+
+            if (touch == 2) break;
+        }
+    }
+
+    return count;
+}
+
+void task_graph_compile(TaskGraph* graph) {
+    const int count   = graph->tasks_count;
+    int* stamps       = malloc(sizeof(int) * (count + 1));
+    int* predecessors = malloc(sizeof(int) * (count + 1));
+    int* cursors      = malloc(sizeof(int) * (count + 1));
+    assert(stamps && predecessors && cursors && "Failed to allocate task graph scratch");
+
+    // Edges always point forward, count the successors of every task before filling them in
+    memset(graph->successor_offsets, 0, sizeof(int) * (count + 1));
+    memset(stamps, 0xff, sizeof(int) * count);
+    for (int j = 0; j < count; j++) {
+        int n                  = task_graph_predecessors(graph, j, stamps, predecessors);
+        graph->dependencies[j] = n;
+        graph->levels[j]       = 0;
+
+        for (int p = 0; p < n; p++) {
+            int i     = predecessors[p];
+            int level = graph->levels[i] + 1;
+            graph->successor_offsets[i + 1]++;
+            graph->levels[j] = level > graph->levels[j] ? level : graph->levels[j];
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        graph->successor_offsets[i + 1] += graph->successor_offsets[i];
+    }
+
+    int edges = graph->successor_offsets[count];
+    if (edges > graph->successors_capacity) {
+        graph->successors          = realloc(graph->successors, sizeof(int) * edges);
+        graph->successors_capacity = edges;
+        assert(graph->successors != NULL && "Failed to grow task graph edges");
+    }
+
+    // Successors of every task end up in ascending order
+    memcpy(cursors, graph->successor_offsets, sizeof(int) * count);
+    memset(stamps, 0xff, sizeof(int) * count);
+    for (int j = 0; j < count; j++) {
+        int n = task_graph_predecessors(graph, j, stamps, predecessors);
+        for (int p = 0; p < n; p++) {
+            graph->successors[cursors[predecessors[p]]++] = j;
+        }
+    }
+
+    free(cursors);
+    free(predecessors);
+    free(stamps);
+    graph->compiled = true;
+}
+
+static void task_graph_job(void* argument) {
+    Task* task       = argument;
+    TaskGraph* graph = task->graph;
+    task->function(task->argument);
+
+    // The last predecessor to finish hands the successor to the pool
+    const int* offsets = graph->successor_offsets;
+    for (int e = offsets[task->index]; e < offsets[task->index + 1]; e++) {
+        int next = graph->successors[e];
+        if (atomic_fetch_sub(&graph->remaining[next], 1) == 1) {
+            thread_pool_run(graph->pool, task_graph_job, &graph->tasks[next], &graph->counter);
+        }
+    }
+}
+
+void task_graph_run(TaskGraph* graph) {
+    if (!graph->compiled) {
+        task_graph_compile(graph);
+    }
+
+    for (int i = 0; i < graph->tasks_count; i++) {
+        atomic_store(&graph->remaining[i], graph->dependencies[i]);
+    }
+
+    atomic_store(&graph->counter.pending, 0);
+    for (int i = 0; i < graph->tasks_count; i++) {
+        if (graph->dependencies[i] == 0) {
+            thread_pool_run(graph->pool, task_graph_job, &graph->tasks[i], &graph->counter);
+        }
+    }
+
+    thread_pool_wait(graph->pool, &graph->counter);
+}
+
+void task_graph_dump(TaskGraph* graph, FILE* out) {
+    if (!graph->compiled) {
+        task_graph_compile(graph);
+    }
+
+    int levels = 0;
+    for (int i = 0; i < graph->tasks_count; i++) {
+        levels = graph->levels[i] + 1 > levels ? graph->levels[i] + 1 : levels;
+    }
+
+    fprintf(out, "task graph: %d tasks in %d levels\n", graph->tasks_count, levels);
+    for (int level = 0; level < levels; level++) {
+        fprintf(out, "level %d:\n", level);
+
+        for (int j = 0; j < graph->tasks_count; j++) {
+            if (graph->levels[j] != level) continue;
+
+            // Predecessors are found again from the edges, they are not kept per task
+            fprintf(out, "  %s", graph->tasks[j].name);
+            const int* offsets    = graph->successor_offsets;
+            const char* separator = " <- ";
+            for (int i = 0; i < j; i++) {
+                for (int e = offsets[i]; e < offsets[i + 1]; e++) {
+                    if (graph->successors[e] != j) continue;
+
+                    fprintf(out, "%s%s", separator, graph->tasks[i].name);
+                    separator = ", ";
+                }
+            }
+
+            fprintf(out, "\n");
+        }
+    }
+}
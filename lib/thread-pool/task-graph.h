@@ -0,0 +1,81 @@
+#ifndef LIB_THREAD_POOL_TASK_GRAPH_H_
+#define LIB_THREAD_POOL_TASK_GRAPH_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "thread-pool/thread-pool.h"
+
+#define TASK_GRAPH_MAX_TASKS    1024
+#define TASK_GRAPH_MAX_ACCESSES 8
+#define TASK_GRAPH_NAME_LENGTH  32
+
+typedef struct TaskGraph TaskGraph;
+
+// Resources are plain addresses, two tasks touch the same resource when they name the same one
+typedef struct TaskAccess {
+    const void* resource;
+    bool write;
+} TaskAccess;
+
+typedef struct Task {
+    TaskGraph* graph;
+    int index;
+    char name[TASK_GRAPH_NAME_LENGTH];
+    JobFunction function;
+    void* argument;
+    TaskAccess accesses[TASK_GRAPH_MAX_ACCESSES];
+    int accesses_count;
+} Task;
+
+// Tasks in the order they were added. A task runs after every earlier task it conflicts with:
+// the last earlier writer of anything it touches, and for a write every reader since that writer.
+// Everything else is free to run next to it.
+typedef struct TaskGraph {
+    ThreadPool* pool;
+    Task tasks[TASK_GRAPH_MAX_TASKS];
+    int tasks_count;
+
+    // NOTE: Resolved schedule, rebuilt by the first run after a task or access was added
+    bool compiled;
+    int dependencies[TASK_GRAPH_MAX_TASKS];  // direct predecessors of every task
+    int levels[TASK_GRAPH_MAX_TASKS];        // longest chain of predecessors, for the dump
+    int successor_offsets[TASK_GRAPH_MAX_TASKS + 1];
+    int* successors;
+    int successors_capacity;
+
+    // NOTE: Run state
+    atomic_int remaining[TASK_GRAPH_MAX_TASKS];
+    JobCounter counter;
+} TaskGraph;
+
+TaskGraph* task_graph_new(ThreadPool* pool);
+
+void task_graph_free(TaskGraph* graph);
+
+// Drops every task, the graph is built anew from the next task_graph_add on
+void task_graph_clear(TaskGraph* graph);
+
+/**
+ * Adds a task, ordered after the tasks added before it that touch the same resources.
+ *
+ * @param name Label for the dump, cut to TASK_GRAPH_NAME_LENGTH - 1 characters
+ * @return Index of the task to declare its reads and writes on
+ */
+int task_graph_add(TaskGraph* graph, const char* name, JobFunction function, void* argument);
+
+void task_graph_read(TaskGraph* graph, int task, const void* resource);
+
+void task_graph_write(TaskGraph* graph, int task, const void* resource);
+
+// Resolves the dependencies, task_graph_run does so itself whenever the graph changed
+void task_graph_compile(TaskGraph* graph);
+
+// Runs every task on the pool as soon as its predecessors are done and waits for all of them
+void task_graph_run(TaskGraph* graph);
+
+// Writes the resolved schedule, every task by level with the tasks it waits for
+void task_graph_dump(TaskGraph* graph, FILE* out);
+
+#endif  // LIB_THREAD_POOL_TASK_GRAPH_H_
@@ -1,96 +1,440 @@
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
 #include "thread-pool.h"
 
 #include <assert.h>
-#include <pthread/sched.h>
-#include <stdatomic.h>
-#include <stdbool.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static void* worker_thread(void* arg) {
-    ThreadPool* pool = (ThreadPool*)arg;
-    while (!atomic_load(&pool->stop)) {
-        int tail = atomic_load(&pool->tail);
-        int head = atomic_load(&pool->head);
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
-        if (head == tail) {
-            sched_yield();
-            continue;
-        }
+static void futex_wait(atomic_uint* word, unsigned int value) {
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* word, int count) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#if !defined(__linux__)
+// Without futexes every waiter shares one condition, a wake is a broadcast and waiters recheck
+static pthread_mutex_t futex_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t futex_cond  = PTHREAD_COND_INITIALIZER;
+
+static void futex_wait(atomic_uint* word, unsigned int value) {
+    pthread_mutex_lock(&futex_lock);
+    if (atomic_load(word) == value) {
+        pthread_cond_wait(&futex_cond, &futex_lock);
+    }
+    pthread_mutex_unlock(&futex_lock);
+}
+
+static void futex_wake(atomic_uint* word, int count) {
+    pthread_mutex_lock(&futex_lock);
+    pthread_cond_broadcast(&futex_cond);
+    pthread_mutex_unlock(&futex_lock);
+}
+#endif
+
+// Worker the calling thread belongs to, NULL on threads the pools did not start
+static _Thread_local ThreadPoolWorker* current_worker;
+
+static ThreadPoolWorker* thread_pool_self(ThreadPool* pool) {
+    return current_worker != NULL && current_worker->pool == pool ? current_worker : NULL;
+}
+
+static void job_slot_store(JobSlot* slot, const Job* job) {
+    atomic_store_explicit(&slot->function, job->function, memory_order_relaxed);
+    atomic_store_explicit(&slot->argument, job->argument, memory_order_relaxed);
+    atomic_store_explicit(&slot->counter, job->counter, memory_order_relaxed);
+}
+
+static Job job_slot_load(JobSlot* slot) {
+    return (Job){
+        .function = atomic_load_explicit(&slot->function, memory_order_relaxed),
+        .argument = atomic_load_explicit(&slot->argument, memory_order_relaxed),
+        .counter  = atomic_load_explicit(&slot->counter, memory_order_relaxed),
+    };
+}
+
+static bool job_deque_push(JobDeque* deque, const Job* job) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long top    = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (bottom - top >= THREAD_POOL_DEQUE_CAPACITY) return false;
+
+    job_slot_store(&deque->slots[bottom % THREAD_POOL_DEQUE_CAPACITY], job);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return true;
+}
+
+static bool job_deque_pop(JobDeque* deque, Job* job) {
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return false;
+    }
+
+    *job = job_slot_load(&deque->slots[bottom % THREAD_POOL_DEQUE_CAPACITY]);
+    if (top < bottom) return true;
+
+    // The last job, whoever moves top past it owns it
+    bool won = atomic_compare_exchange_strong_explicit(
+        &deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return won;
+}
+
+static bool job_deque_steal(JobDeque* deque, Job* job) {
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) return false;
+
+    // Read before claiming, the slot can only be reused once top moved past it
+    *job = job_slot_load(&deque->slots[top % THREAD_POOL_DEQUE_CAPACITY]);
+    return atomic_compare_exchange_strong_explicit(
+        &deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static bool thread_pool_queue_push(ThreadPool* pool, const Job* job) {
+    pthread_mutex_lock(&pool->queue_lock);
+    int count = atomic_load_explicit(&pool->queue_count, memory_order_relaxed);
+    bool room = count < THREAD_POOL_QUEUE_CAPACITY;
+    if (room) {
+        pool->queue[(pool->queue_head + count) % THREAD_POOL_QUEUE_CAPACITY] = *job;
+        atomic_store(&pool->queue_count, count + 1);
+    }
+
+    pthread_mutex_unlock(&pool->queue_lock);
+    return room;
+}
+
+static bool thread_pool_queue_pop(ThreadPool* pool, Job* job) {
+    if (atomic_load(&pool->queue_count) == 0) return false;
+
+    pthread_mutex_lock(&pool->queue_lock);
+    int count  = atomic_load_explicit(&pool->queue_count, memory_order_relaxed);
+    bool found = count > 0;
+    if (found) {
+        *job             = pool->queue[pool->queue_head];
+        pool->queue_head = (pool->queue_head + 1) % THREAD_POOL_QUEUE_CAPACITY;
+        atomic_store(&pool->queue_count, count - 1);
+    }
+
+    pthread_mutex_unlock(&pool->queue_lock);
+    return found;
+}
+
+static void thread_pool_execute(const Job* job) {
+    job->function(job->argument);
+
+    // The waiter may return and drop the counter as soon as it reads zero, the wake only needs
+    // the address and never touches the memory behind it
+    if (job->counter != NULL && atomic_fetch_sub(&job->counter->pending, 1) == 1) {
+        futex_wake(&job->counter->pending, INT_MAX);
+    }
+}
+
+static unsigned int thread_pool_random(ThreadPoolWorker* self) {
+    self->seed ^= self->seed << 13;
+    self->seed ^= self->seed >> 17;
+    self->seed ^= self->seed << 5;
+    return self->seed;
+}
+
+// Own deque first, newest job on top of the cache, then the oldest jobs of everyone else
+static bool thread_pool_find(ThreadPool* pool, ThreadPoolWorker* self, Job* job) {
+    if (self != NULL && job_deque_pop(&self->deque, job)) return true;
+    if (thread_pool_queue_pop(pool, job)) return true;
+    if (pool->workers_count == 0) return false;
+
+    unsigned int start = self != NULL ? thread_pool_random(self) : 0;
+    for (int i = 0; i < pool->workers_count; i++) {
+        ThreadPoolWorker* victim = &pool->workers[(start + i) % pool->workers_count];
+        if (victim != self && job_deque_steal(&victim->deque, job)) return true;
+    }
+
+    return false;
+}
+
+static void thread_pool_wake(ThreadPool* pool) {
+    // Pairs with the fence in thread_pool_park, either the sleeper finds the job or sees it here
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&pool->sleepers, memory_order_relaxed) == 0) return;
+
+    atomic_fetch_add(&pool->wake_epoch, 1);
+    futex_wake(&pool->wake_epoch, 1);
+}
+
+// Parks the worker until a job arrives, unless one turns up after announcing itself
+static bool thread_pool_park(ThreadPool* pool, ThreadPoolWorker* self, Job* job) {
+    unsigned int epoch = atomic_load(&pool->wake_epoch);
+    atomic_fetch_add(&pool->sleepers, 1);
+    atomic_thread_fence(memory_order_seq_cst);
 
-        // Try to take this task
-        Task* task = &pool->tasks[tail];
+    bool found = thread_pool_find(pool, self, job);
+    if (!found && !atomic_load(&pool->stop)) {
+        futex_wait(&pool->wake_epoch, epoch);
+    }
 
-        // Advance tail BEFORE execution to prevent other threads from taking it
-        atomic_store(&pool->tail, (tail + 1) % MAX_THREAD_POOL_TASKS);
+    atomic_fetch_sub(&pool->sleepers, 1);
+    return found;
+}
+
+static void* thread_pool_worker(void* arg) {
+    ThreadPoolWorker* self = arg;
+    ThreadPool* pool       = self->pool;
+    current_worker         = self;
+
+    int idle = 0;
+    while (!atomic_load(&pool->stop)) {
+        Job job;
+        bool found = thread_pool_find(pool, self, &job);
+        if (!found && idle >= THREAD_POOL_SPINS) {
+            found = thread_pool_park(pool, self, &job);
+        }
 
-        if (task->function) {
-            task->function(task->argument);
-            atomic_store(&task->completed, true);
+        if (found) {
+            thread_pool_execute(&job);
+            idle = 0;
+        } else {
+            idle = idle < THREAD_POOL_SPINS ? idle + 1 : 0;
         }
     }
+
     return NULL;
 }
 
-Task* thread_pool_push(ThreadPool* pool, void (*function)(void*), void* args) {
-    int head      = atomic_load(&pool->head);
-    int tail      = atomic_load(&pool->tail);
-    int next_head = (head + 1) % MAX_THREAD_POOL_TASKS;
+void thread_pool_run(ThreadPool* pool, JobFunction function, void* argument, JobCounter* counter) {
+    assert(pool != NULL && "Thread pool cannot be NULL");
+    assert(function != NULL && "Job function cannot be NULL");
 
-    if (next_head == tail) {
-        return NULL;
+    Job job = {function, argument, counter};
+    if (counter != NULL) {
+        atomic_fetch_add(&counter->pending, 1);
     }
 
-    // Set up task before advancing head
-    atomic_store(&pool->tasks[head].completed, false);  // Ensure it starts as false
-    pool->tasks[head].function = function;
-    pool->tasks[head].argument = args;
+    ThreadPoolWorker* self = thread_pool_self(pool);
+    bool queued            = self != NULL ? job_deque_push(&self->deque, &job)
+                                          : thread_pool_queue_push(pool, &job);
+    if (!queued) {
+        // Backed up, running it here throttles whoever floods the pool
+        thread_pool_execute(&job);
+        return;
+    }
 
-    atomic_store(&pool->head, next_head);
-    return &pool->tasks[head];
+    thread_pool_wake(pool);
 }
 
-bool thread_pool_complete(ThreadPool* pool, Task* task) {
-    return atomic_load(&task->completed);
-}
+void thread_pool_wait(ThreadPool* pool, JobCounter* counter) {
+    assert(pool != NULL && "Thread pool cannot be NULL");
+    assert(counter != NULL && "Job counter cannot be NULL");
+
+    ThreadPoolWorker* self = thread_pool_self(pool);
+    for (;;) {
+        unsigned int pending = atomic_load(&counter->pending);
+        if (pending == 0) return;
 
-void thread_pool_wait(ThreadPool* pool, Task* task) {
-    while (!atomic_load(&task->completed)) {
-        atomic_thread_fence(memory_order_acquire);
-        sched_yield();
+        Job job;
+        if (thread_pool_find(pool, self, &job)) {
+            thread_pool_execute(&job);
+        } else {
+            futex_wait(&counter->pending, pending);
+        }
     }
 }
 
 void thread_pool_destroy(ThreadPool* pool) {
-    if (!pool) return;
+    if (pool == NULL) return;
 
-    // Signal threads to stop
     atomic_store(&pool->stop, true);
+    atomic_fetch_add(&pool->wake_epoch, 1);
+    futex_wake(&pool->wake_epoch, INT_MAX);
 
-    // Wait for all threads to finish
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        pthread_join(pool->threads[i], NULL);
+    for (int i = 0; i < pool->workers_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
     }
 
+    pthread_mutex_destroy(&pool->queue_lock);
+    free(pool->workers);
     free(pool);
 }
 
-ThreadPool* thread_pool_create() {
-    ThreadPool* pool = malloc(sizeof(ThreadPool));
-    assert(pool != NULL && "Thread pool cannot be NULL");
+ThreadPool* thread_pool_create(int workers) {
+    assert(workers >= 0 && "Worker count cannot be negative");
 
+    // The pool and the deques are aligned to cache lines, which calloc does not promise
+    ThreadPool* pool = aligned_alloc(alignof(ThreadPool), sizeof(ThreadPool));
+    assert(pool != NULL && "Thread pool cannot be NULL");
     memset(pool, 0, sizeof(ThreadPool));
-    atomic_init(&pool->head, 0);
-    atomic_init(&pool->tail, 0);
-    atomic_init(&pool->stop, false);
+    pthread_mutex_init(&pool->queue_lock, NULL);
 
-    for (int i = 0; i < THREAD_COUNT; i++) {
-        if (pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0) {
+    if (workers > 0) {
+        size_t size   = sizeof(ThreadPoolWorker) * workers;
+        pool->workers = aligned_alloc(alignof(ThreadPoolWorker), size);
+        assert(pool->workers != NULL && "Failed to allocate workers");
+        memset(pool->workers, 0, size);
+    }
+
+    for (int i = 0; i < workers; i++) {
+        ThreadPoolWorker* worker = &pool->workers[i];
+        worker->pool             = pool;
+        worker->index            = i;
+        worker->seed             = i * 2654435761u + 1;
+
+        if (pthread_create(&worker->thread, NULL, thread_pool_worker, worker) != 0) {
             thread_pool_destroy(pool);
             return NULL;
         }
+
+        pool->workers_count++;
     }
 
     return pool;
 }
+
+int thread_pool_cpu_count(void) {
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) return CPU_COUNT(&set);
+#endif
+
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+#else
+    return 1;
+#endif
+}
+
+#if defined(__linux__)
+static int thread_pool_topology_read(const char* name, int cpu, int fallback) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return fallback;
+
+    int value = fallback;
+    if (fscanf(file, "%d", &value) != 1) value = fallback;
+    fclose(file);
+    return value;
+}
+
+// CPUs of the process with the first of every physical core up front and the siblings after it,
+// cores is set to how many firsts there are. Without topology in sysfs every CPU counts as a core
+// of its own.
+static int thread_pool_cpus(int* cpus, int* cores_count) {
+    cpu_set_t set;
+    *cores_count = 0;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return 0;
+
+    int cores[CPU_SETSIZE];
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+
+        int package  = thread_pool_topology_read("physical_package_id", cpu, 0);
+        int core     = thread_pool_topology_read("core_id", cpu, cpu);
+        cores[count] = package << 16 | core;
+        cpus[count]  = cpu;
+        count++;
+    }
+
+    int firsts[CPU_SETSIZE];
+    int siblings[CPU_SETSIZE];
+    int firsts_count   = 0;
+    int siblings_count = 0;
+    for (int i = 0; i < count; i++) {
+        bool sibling = false;
+        for (int j = 0; j < i && !sibling; j++) {
+            sibling = cores[j] == cores[i];
+        }
+
+        if (sibling) {
+            siblings[siblings_count++] = cpus[i];
+        } else {
+            firsts[firsts_count++] = cpus[i];
+        }
+    }
+
+    memcpy(cpus, firsts, sizeof(int) * firsts_count);
+    memcpy(cpus + firsts_count, siblings, sizeof(int) * siblings_count);
+    *cores_count = firsts_count;
+    return count;
+}
+
+static bool thread_pool_pin_cpu(pthread_t thread, int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+#endif
+
+int thread_pool_core_count(void) {
+#if defined(__linux__)
+    int cpus[CPU_SETSIZE];
+    int cores = 0;
+    thread_pool_cpus(cpus, &cores);
+    if (cores > 0) return cores;
+#endif
+
+    return thread_pool_cpu_count();
+}
+
+int thread_pool_pin(ThreadPool* pool, int reserved) {
+    assert(pool != NULL && "Thread pool cannot be NULL");
+    assert(reserved >= 0 && "Reserved cores cannot be negative");
+
+#if defined(__linux__)
+    int cpus[CPU_SETSIZE];
+    int cores  = 0;
+    int count  = thread_pool_cpus(cpus, &cores);
+    int pinned = 0;
+    for (int i = 0; i < pool->workers_count && reserved + i < count; i++) {
+        pinned += thread_pool_pin_cpu(pool->workers[i].thread, cpus[reserved + i]);
+    }
+
+    return pinned;
+#else
+    (void)reserved;
+    return 0;
+#endif
+}
+
+bool thread_pool_pin_reserved(pthread_t thread, int core) {
+    assert(core >= 0 && "Reserved core cannot be negative");
+
+#if defined(__linux__)
+    int cpus[CPU_SETSIZE];
+    int cores = 0;
+    int count = thread_pool_cpus(cpus, &cores);
+    return core < count && thread_pool_pin_cpu(thread, cpus[core]);
+#else
+    (void)thread;
+    return false;
+#endif
+}
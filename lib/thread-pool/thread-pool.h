@@ -2,37 +2,122 @@
 #define LIB_THREAD_POOL_THREAD_POOL
 
 #include <pthread.h>
+#include <stdalign.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 
-#define MAX_THREAD_POOL_TASKS 256
-#define THREAD_COUNT          8
+// Jobs a worker deque or the shared queue holds, a job that finds them full runs right away
+#define THREAD_POOL_DEQUE_CAPACITY 4096
+#define THREAD_POOL_QUEUE_CAPACITY 4096
 
-typedef struct Task {
-    void (*function)(void*);
+// Times an idle worker looks for work again before it parks
+#define THREAD_POOL_SPINS 64
+
+typedef void (*JobFunction)(void* argument);
+
+// Jobs still running under the counter. Zero it before the first job, then hand it to every job
+// of one batch and wait on it once. It must outlive the wait.
+typedef struct JobCounter {
+    atomic_uint pending;
+} JobCounter;
+
+// Fields are read without a lock by thieves racing the owner, a torn read is always thrown away
+typedef struct JobSlot {
+    _Atomic(JobFunction) function;
+    _Atomic(void*) argument;
+    _Atomic(JobCounter*) counter;
+} JobSlot;
+
+typedef struct Job {
+    JobFunction function;
     void* argument;
-    atomic_bool completed;
-} Task;
+    JobCounter* counter;
+} Job;
+
+// Chase-Lev deque, the owning worker pushes and pops at the bottom while the others steal from
+// the top. Both ends live on their own cache line.
+typedef struct JobDeque {
+    alignas(64) atomic_long top;
+    alignas(64) atomic_long bottom;
+    JobSlot slots[THREAD_POOL_DEQUE_CAPACITY];
+} JobDeque;
+
+typedef struct ThreadPool ThreadPool;
+
+typedef struct ThreadPoolWorker {
+    JobDeque deque;
+    ThreadPool* pool;
+    pthread_t thread;
+    unsigned int seed;  // picks the first victim to steal from
+    int index;
+} ThreadPoolWorker;
 
 typedef struct ThreadPool {
-    Task tasks[MAX_THREAD_POOL_TASKS];
-    pthread_t threads[THREAD_COUNT];
-    atomic_int head;
-    atomic_int tail;
+    ThreadPoolWorker* workers;
+    int workers_count;
+
+    // Jobs pushed by threads that are not workers of the pool
+    pthread_mutex_t queue_lock;
+    Job queue[THREAD_POOL_QUEUE_CAPACITY];
+    int queue_head;
+    atomic_int queue_count;
+
+    // Parked workers sleep on wake_epoch, bumped whenever a job arrives while one of them is down
+    alignas(64) atomic_uint wake_epoch;
+    atomic_int sleepers;
     atomic_bool stop;
 } ThreadPool;
 
-Task* thread_pool_push(ThreadPool* pool, void (*function)(void*), void* arg);
+/**
+ * Starts a pool of worker threads. A pool without workers is valid, its jobs run on the thread
+ * that waits for them.
+ *
+ * @param workers Number of worker threads, the waiting thread helps out on top of them
+ * @return The pool, or NULL when a thread could not be started
+ */
+ThreadPool* thread_pool_create(int workers);
+
+// Stops and joins the workers, jobs still queued are dropped
+void thread_pool_destroy(ThreadPool* pool);
 
-Task* thread_pool_pop(ThreadPool* pool);
+// Logical CPUs the process may run on, at least 1
+int thread_pool_cpu_count(void);
 
-void thread_pool_wait(ThreadPool* pool, Task* task);
+// Physical cores the process may run on, at least 1. Only Linux tells hyperthread siblings apart,
+// elsewhere this is the logical CPU count.
+int thread_pool_core_count(void);
 
-bool thread_pool_complete(ThreadPool* pool, Task* task);
+/**
+ * Pins every worker to a CPU of its own, one per physical core before any hyperthread sibling.
+ * Only Linux pins, elsewhere the scheduler keeps placing the workers.
+ *
+ * @param reserved Leading cores left to threads outside the pool, like the render thread
+ * @return Number of workers pinned, the rest run wherever there is room once the CPUs run out
+ */
+int thread_pool_pin(ThreadPool* pool, int reserved);
 
-void thread_pool_destroy(ThreadPool* pool);
+/**
+ * Pins a thread outside the pool to one of the cores thread_pool_pin reserved, in the same order
+ * the workers are handed theirs. Only Linux pins.
+ *
+ * @param core Reserved core, below the reserved count given to thread_pool_pin
+ * @return false when the thread was left to the scheduler
+ */
+bool thread_pool_pin_reserved(pthread_t thread, int core);
+
+/**
+ * Queues a job. Workers push to their own deque, any other thread to the shared queue.
+ *
+ * @param counter Counter the job is accounted to, or NULL when nobody waits on it
+ */
+void thread_pool_run(ThreadPool* pool, JobFunction function, void* argument, JobCounter* counter);
 
-ThreadPool* thread_pool_create();
+/**
+ * Runs queued jobs until every job of the counter is done, then parks on the counter once there
+ * is nothing left to take. The jobs of a counter are expected to be queued by the waiting thread
+ * or by jobs of the same counter.
+ */
+void thread_pool_wait(ThreadPool* pool, JobCounter* counter);
 
 #endif  // LIB_THREAD_POOL_THREAD_POOL
@@ -5,6 +5,13 @@
 ---@class Entity
 ---@field get_position fun(self:Entity): x:number, y:number
 ---@field set_position fun(self:Entity, x:number,y:number)
+---@field get_rotation fun(self:Entity): radians:number
+---@field set_rotation fun(self:Entity, radians:number)
+---@field get_scale fun(self:Entity): x:number, y:number
+---@field set_scale fun(self:Entity, x:number,y:number)
+---@field get_layer fun(self:Entity): layer:integer
+---@field set_layer fun(self:Entity, layer:integer)
+---@field set_parent fun(self:Entity, parent:Entity|nil)
 
 ---@class Body : Entity
 ---@field get_type fun(self:Body): integer
@@ -24,6 +31,7 @@
 ---@field sprite integer
 ---@field row? integer
 ---@field col? integer
+---@field layer? integer Render layer in [0, 16), drawn in ascending order
 
 ---@class EntityDef
 ---@field sprite? number
@@ -58,6 +66,9 @@
 ---@field create_static_body fun(self:World, definition:StaticDef): any
 ---@field create_sprite fun(self:World, definition:SpriteDef): any
 ---@field create_box_collider fun(self:World, definition: BoxColliderDef): any
+---@field set_camera fun(self:World, x: number, y: number)
+---@field set_layer fun(self:World, layer: integer, ysort: boolean) Static layers (ysort false) draw in creation order
+---@field set_tick_rate fun(self:World, hz: number) Fixed simulation rate, 60 by default. Frames between ticks are interpolated
 
 ---@class Input
 ---@field is_down fun(key:integer): boolean
@@ -0,0 +1,31 @@
+#ifndef TESTS_BENCH_H_
+#define TESTS_BENCH_H_
+
+#include <stdlib.h>
+#include <time.h>
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline int bench_compare_double(const void* a, const void* b) {
+    const double da = *(const double*)a;
+    const double db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+// Sorts the samples in place and returns the median
+static inline double bench_median(double* samples, int count) {
+    qsort(samples, count, sizeof(double), bench_compare_double);
+    return samples[count / 2];
+}
+
+// Sorts the samples in place and returns the nearest rank percentile, 0.99 for the p99
+static inline double bench_percentile(double* samples, int count, double percentile) {
+    qsort(samples, count, sizeof(double), bench_compare_double);
+    return samples[(int)(percentile * (count - 1) + 0.5)];
+}
+
+#endif  // TESTS_BENCH_H_
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "scene-graph/graph-sort.h"
+#include "scene-graph/parallel-graph-sort.h"
+#include "scene-graph/scene-graph.h"
+#include "thread-pool/thread-pool.h"
+
+// Enough samples for the p99 to be an actual sample rather than the slowest one
+#define SAMPLES 101
+
+typedef enum Shape {
+    SHAPE_FLAT,
+    SHAPE_DEEP,
+    SHAPE_WIDE,
+    SHAPE_MIXED,
+    SHAPE_COUNT,
+} Shape;
+
+static const char* shape_names[SHAPE_COUNT] = {"flat", "deep", "wide", "mixed"};
+
+typedef enum Op {
+    OP_NODE_NEW,
+    OP_COMPUTE_POSITIONS,
+    OP_YSORT,
+    OP_YSORT_PARALLEL,
+    OP_UPDATE,
+    OP_RENDER,
+    OP_DESTROY,
+    OP_COUNT,
+} Op;
+
+static const char* op_names[OP_COUNT] = {
+    "node_new",
+    "compute_positions",
+    "ysort",
+    "ysort_parallel",
+    "update",
+    "render",
+    "destroy",
+};
+
+// Parent of node i, every parent comes before its children
+static int shape_parent(Shape shape, int i) {
+    switch (shape) {
+        case SHAPE_FLAT:
+            return 0;
+        case SHAPE_DEEP:
+            // Chains of 256 nodes hanging off the root
+            return i % 256 == 1 ? 0 : i - 1;
+        case SHAPE_WIDE:
+            // Every node fans out into 16 children
+            return (i - 1) / 16;
+        default:
+            // Squads of sprites under the root, now and then a squad nested in another one's chain
+            if (i % 8 == 1) return rand() % 16 == 0 ? rand() % i : 0;
+            return rand() % 4 == 0 ? i - 1 : i - (i - 1) % 8;
+    }
+}
+
+static void noop_update(SceneGraph* graph, GameObject* object) {
+}
+
+static void noop_draw(const Drawable* drawable, const Transform2D* transform) {
+}
+
+static void scatter(SceneGraph* graph, const Node* nodes, int count) {
+    for (int i = 1; i < count; i++) {
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 64, rand() % 64});
+    }
+}
+
+// One sample of every op on a freshly built graph, in the order a frame would run them
+static void bench_sample(Shape shape, int count, ThreadPool* pool, Node* nodes, double* times) {
+    SceneGraph* graph = scene_graph_new();
+
+    double start = bench_now();
+    nodes[0]     = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[shape_parent(shape, i)]);
+    }
+    times[OP_NODE_NEW] = bench_now() - start;
+
+    for (int i = 1; i < count; i++) {
+        GameObject* object = scene_graph_game_object_new(graph, nodes[i]);
+        object->update     = noop_update;
+
+        Drawable* drawable = scene_graph_drawable_new(graph, nodes[i]);
+        drawable->draw     = noop_draw;
+    }
+
+    scatter(graph, nodes, count);
+    start = bench_now();
+    scene_graph_compute_positions(graph);
+    times[OP_COMPUTE_POSITIONS] = bench_now() - start;
+
+    start = bench_now();
+    scene_graph_ysort(graph);
+    times[OP_YSORT] = bench_now() - start;
+
+    scatter(graph, nodes, count);
+    scene_graph_compute_positions(graph);
+    start = bench_now();
+    scene_graph_ysort_parallel(graph, pool);
+    times[OP_YSORT_PARALLEL] = bench_now() - start;
+
+    start = bench_now();
+    scene_graph_update(graph);
+    times[OP_UPDATE] = bench_now() - start;
+
+    start = bench_now();
+    scene_graph_render(graph);
+    times[OP_RENDER] = bench_now() - start;
+
+    // Destruction is deferred, the sibling links hold until the removal
+    start      = bench_now();
+    Node child = scene_graph_first_child_get(graph, nodes[0]);
+    while (child != NODE_NULL) {
+        scene_graph_node_destroy(graph, child);
+        child = scene_graph_sibling_get(graph, child);
+    }
+    scene_graph_remove_destroyed_nodes(graph);
+    times[OP_DESTROY] = bench_now() - start;
+
+    scene_graph_free(graph);
+}
+
+static void bench_shape(Shape shape, int count, ThreadPool* pool) {
+    static double samples[OP_COUNT][SAMPLES];
+    Node* nodes = malloc(sizeof(Node) * count);
+
+    for (int s = 0; s < SAMPLES; s++) {
+        double times[OP_COUNT];
+        bench_sample(shape, count, pool, nodes, times);
+        for (int op = 0; op < OP_COUNT; op++) {
+            samples[op][s] = times[op];
+        }
+    }
+
+    for (int op = 0; op < OP_COUNT; op++) {
+        printf("scene_graph shape=%s nodes=%d op=%s median_us=%.1f p99_us=%.1f\n",
+               shape_names[shape],
+               count,
+               op_names[op],
+               bench_percentile(samples[op], SAMPLES, 0.5) * 1e6,
+               bench_percentile(samples[op], SAMPLES, 0.99) * 1e6);
+    }
+
+    free(nodes);
+}
+
+// Usage: bench_scene_graph [nodes...], 10000 and 100000 nodes when none are given
+int main(int argc, char** argv) {
+    srand(42);
+    ThreadPool* pool = thread_pool_create(thread_pool_cpu_count() - 1);
+
+    const int defaults[] = {10000, 100000};
+    for (int i = 0; i < (argc > 1 ? argc - 1 : 2); i++) {
+        int count = argc > 1 ? atoi(argv[i + 1]) : defaults[i];
+        if (count < 2 || count > SCENE_GRAPH_MAX_NODES) {
+            fprintf(stderr, "bench_scene_graph: node count must lie in [2, %d]\n", SCENE_GRAPH_MAX_NODES);
+            return EXIT_FAILURE;
+        }
+
+        for (int shape = 0; shape < SHAPE_COUNT; shape++) {
+            bench_shape(shape, count, pool);
+        }
+    }
+
+    thread_pool_destroy(pool);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "scene-graph/graph-sort.h"
+#include "scene-graph/scene-graph.h"
+#include "scene-graph/snapshot.h"
+
+#define SAMPLES 25
+
+// Drawable sprites in small squads under the root, sorted once up front
+static SceneGraph* build_graph(Node* nodes, int count) {
+    SceneGraph* graph = scene_graph_new();
+    nodes[0]          = scene_graph_node_new(graph, NODE_NULL);
+
+    for (int i = 1; i < count; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[i % 8 == 1 ? 0 : i - 1]);
+        scene_graph_drawable_new(graph, nodes[i]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 4096, rand() % 4096});
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    return graph;
+}
+
+static void step(SceneGraph* graph, const Node* nodes, int count, int movers) {
+    for (int i = 0; i < movers; i++) {
+        Node node  = nodes[1 + rand() % (count - 1)];
+        Position p = scene_graph_local_position_get(graph, node);
+        scene_graph_local_position_set(graph, node, (Position){p.x, p.y + rand() % 9 - 4});
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+}
+
+// Capture and restore cost of a frame where movers nodes took a step since the base was taken
+static void bench_snapshot(int count, int movers) {
+    Node* nodes          = malloc(sizeof(Node) * count);
+    SceneGraph* graph    = build_graph(nodes, count);
+    SceneSnapshot* base  = scene_snapshot_new();
+    SceneSnapshot* delta = scene_snapshot_new();
+    SceneSnapshot* full  = scene_snapshot_new();
+    double full_samples[SAMPLES];
+    double delta_samples[SAMPLES];
+    double restore_samples[SAMPLES];
+    double restore_delta_samples[SAMPLES];
+
+    for (int s = 0; s < SAMPLES; s++) {
+        scene_graph_snapshot(graph, base, NULL);
+        step(graph, nodes, count, movers);
+
+        double start     = bench_now();
+        scene_graph_snapshot(graph, full, NULL);
+        full_samples[s]  = bench_now() - start;
+
+        start            = bench_now();
+        scene_graph_snapshot(graph, delta, base);
+        delta_samples[s] = bench_now() - start;
+
+        step(graph, nodes, count, movers);
+        start              = bench_now();
+        scene_graph_restore(graph, full, NULL);
+        restore_samples[s] = bench_now() - start;
+
+        step(graph, nodes, count, movers);
+        start                    = bench_now();
+        scene_graph_restore(graph, delta, base);
+        restore_delta_samples[s] = bench_now() - start;
+    }
+
+    printf("snapshot nodes=%d movers=%d full_kb=%zu delta_kb=%zu full_us=%.1f delta_us=%.1f restore_us=%.1f "
+           "restore_delta_us=%.1f\n",
+           count,
+           movers,
+           full->size / 1024,
+           (size_t)delta->blocks_count * SCENE_SNAPSHOT_BLOCK / 1024,
+           bench_median(full_samples, SAMPLES) * 1e6,
+           bench_median(delta_samples, SAMPLES) * 1e6,
+           bench_median(restore_samples, SAMPLES) * 1e6,
+           bench_median(restore_delta_samples, SAMPLES) * 1e6);
+
+    scene_snapshot_free(full);
+    scene_snapshot_free(delta);
+    scene_snapshot_free(base);
+    scene_graph_free(graph);
+    free(nodes);
+}
+
+int main(void) {
+    srand(42);
+
+    bench_snapshot(10000, 10);
+    bench_snapshot(10000, 1000);
+    bench_snapshot(100000, 10);
+    bench_snapshot(100000, 10000);
+    return 0;
+}
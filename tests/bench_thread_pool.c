@@ -0,0 +1,125 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "thpool/thpool.h"
+#include "thread-pool/thread-pool.h"
+
+#define SAMPLES 25
+
+// Work per job in iterations of a dependent multiply-add, roughly a nanosecond each
+static const int job_sizes[] = {0, 1000, 20000};
+
+static atomic_long sink;
+
+static void spin_job(void* argument) {
+    long iterations = (long)(size_t)argument;
+    long value      = 1;
+    for (long i = 0; i < iterations; i++) {
+        value = value * 6364136223846793005L + 1442695040888963407L;
+    }
+
+    atomic_fetch_add_explicit(&sink, value, memory_order_relaxed);
+}
+
+static double bench_thpool(threadpool pool, int jobs, long size) {
+    double start = bench_now();
+    for (int i = 0; i < jobs; i++) {
+        thpool_add_work(pool, spin_job, (void*)(size_t)size);
+    }
+
+    thpool_wait(pool);
+    return bench_now() - start;
+}
+
+static double bench_thread_pool(ThreadPool* pool, int jobs, long size) {
+    JobCounter counter = {0};
+    double start       = bench_now();
+    for (int i = 0; i < jobs; i++) {
+        thread_pool_run(pool, spin_job, (void*)(size_t)size, &counter);
+    }
+
+    thread_pool_wait(pool, &counter);
+    return bench_now() - start;
+}
+
+typedef struct Fan {
+    ThreadPool* pool;
+    int count;
+    long size;
+} Fan;
+
+// Jobs spawning their own halves, the split the deques and stealing are built for. thpool has
+// no way to wait inside a job, so it only runs the flat variant.
+static void fan_job(void* argument) {
+    Fan* fan = argument;
+    if (fan->count == 1) {
+        spin_job((void*)(size_t)fan->size);
+        return;
+    }
+
+    int half           = fan->count / 2;
+    Fan halves[2]      = {{fan->pool, half, fan->size}, {fan->pool, fan->count - half, fan->size}};
+    JobCounter counter = {0};
+    thread_pool_run(fan->pool, fan_job, &halves[0], &counter);
+    thread_pool_run(fan->pool, fan_job, &halves[1], &counter);
+    thread_pool_wait(fan->pool, &counter);
+}
+
+static double bench_fan(ThreadPool* pool, int jobs, long size) {
+    Fan fan            = {pool, jobs, size};
+    JobCounter counter = {0};
+    double start       = bench_now();
+    thread_pool_run(pool, fan_job, &fan, &counter);
+    thread_pool_wait(pool, &counter);
+    return bench_now() - start;
+}
+
+static void report(const char* pool, int workers, int jobs, long size, double* samples) {
+    double median = bench_median(samples, SAMPLES);
+    printf("thread_pool pool=%s workers=%d jobs=%d job_size=%ld median_us=%.1f jobs_per_s=%.0f\n",
+           pool,
+           workers,
+           jobs,
+           size,
+           median * 1e6,
+           jobs / median);
+}
+
+// Usage: bench_thread_pool [workers], 8 workers when none are given
+int main(int argc, char** argv) {
+    int workers = argc > 1 ? atoi(argv[1]) : 8;
+    if (workers < 1) {
+        fprintf(stderr, "bench_thread_pool: worker count must be at least 1\n");
+        return EXIT_FAILURE;
+    }
+
+    threadpool thpool = thpool_init(workers);
+    ThreadPool* pool  = thread_pool_create(workers);
+    double samples[SAMPLES];
+
+    for (int s = 0; s < (int)(sizeof(job_sizes) / sizeof(job_sizes[0])); s++) {
+        long size = job_sizes[s];
+        int jobs  = size == 0 ? 100000 : 2000;
+
+        for (int i = 0; i < SAMPLES; i++) {
+            samples[i] = bench_thpool(thpool, jobs, size);
+        }
+        report("thpool", workers, jobs, size, samples);
+
+        for (int i = 0; i < SAMPLES; i++) {
+            samples[i] = bench_thread_pool(pool, jobs, size);
+        }
+        report("thread_pool", workers, jobs, size, samples);
+
+        for (int i = 0; i < SAMPLES; i++) {
+            samples[i] = bench_fan(pool, jobs, size);
+        }
+        report("thread_pool_fan", workers, jobs, size, samples);
+    }
+
+    thread_pool_destroy(pool);
+    thpool_destroy(thpool);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "scene-graph/scene-graph.h"
+#include "scene-graph/transform-kernel.h"
+
+#define SAMPLES 25
+
+// The recursive walk scene_graph_compute_positions used before storage became parent-first
+static void scene_graph_compute_position_recursive(SceneGraph* graph, Node node) {
+    int index  = scene_graph_index_get(graph, node);
+    int parent = scene_graph_parent_get(graph, node);
+    if (parent != NODE_NULL) {
+        int parent_index              = scene_graph_index_get(graph, parent);
+        Position world_pos            = graph->world_positions[parent_index];
+        Position local_pos            = graph->local_positions[index];
+        graph->world_positions[index] = (Position){
+            .x = world_pos.x + local_pos.x,
+            .y = world_pos.y + local_pos.y,
+        };
+    } else {
+        graph->world_positions[index] = graph->local_positions[index];
+    }
+
+    int next = scene_graph_first_child_get(graph, node);
+    while (next != NODE_NULL) {
+        scene_graph_compute_position_recursive(graph, next);
+        next = scene_graph_sibling_get(graph, next);
+    }
+}
+
+static SceneGraph* build_graph(int count) {
+    SceneGraph* graph = scene_graph_new();
+    Node* nodes       = malloc(sizeof(Node) * count);
+    nodes[0]          = scene_graph_node_new(graph, NODE_NULL);
+
+    // Random recursive tree: shallow on average with a handful of long chains
+    for (int i = 1; i < count; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[rand() % i]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 64, rand() % 64});
+    }
+
+    scene_graph_compute_positions(graph);
+    free(nodes);
+    return graph;
+}
+
+static void bench_transform(int count) {
+    SceneGraph* graph = build_graph(count);
+    Position* wp      = graph->world_positions;
+    Position* lp      = graph->local_positions;
+    int* parents      = graph->parent_indices;
+    uint8_t* dirty    = graph->dirty_flags;
+    int dirty_count   = count / 100;
+
+    double recursive[SAMPLES];
+    double kernel[SAMPLES];
+    double kernel_dirty[SAMPLES];
+
+    for (int s = 0; s < SAMPLES; s++) {
+        double start = bench_now();
+        scene_graph_compute_position_recursive(graph, NODE_ROOT);
+        recursive[s] = bench_now() - start;
+
+        start        = bench_now();
+        scene_graph_transform_kernel(wp, lp, parents, 1, graph->nodes_count);
+        kernel[s] = bench_now() - start;
+
+        int first = graph->nodes_count;
+        for (int i = 0; i < dirty_count; i++) {
+            int index    = 1 + rand() % (graph->nodes_count - 1);
+            dirty[index] = 1;
+            first        = index < first ? index : first;
+        }
+
+        start = bench_now();
+        scene_graph_transform_kernel_dirty(wp, lp, parents, dirty, first, graph->nodes_count);
+        kernel_dirty[s] = bench_now() - start;
+        memset(&dirty[first], 0, graph->nodes_count - first);
+    }
+
+    double recursive_us = bench_median(recursive, SAMPLES) * 1e6;
+    double kernel_us    = bench_median(kernel, SAMPLES) * 1e6;
+    double dirty_us     = bench_median(kernel_dirty, SAMPLES) * 1e6;
+
+    printf("transform nodes=%d recursive_us=%.1f kernel_us=%.1f kernel_dirty_1pct_us=%.1f "
+           "speedup=%.2fx\n",
+           count,
+           recursive_us,
+           kernel_us,
+           dirty_us,
+           recursive_us / kernel_us);
+
+    scene_graph_free(graph);
+}
+
+int main(void) {
+    srand(42);
+
+    bench_transform(1000);
+    bench_transform(10000);
+    bench_transform(100000);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "scene-graph/graph-sort.h"
+#include "scene-graph/parallel-graph-sort.h"
+#include "scene-graph/scene-graph.h"
+#include "thread-pool/thread-pool.h"
+
+#define SAMPLES 25
+
+// Sprites under the root, sorted once up front. The map grows with the node count so the density,
+// and with it how many neighbours a step passes in the order, stays the same.
+static SceneGraph* build_graph(Node* nodes, int count) {
+    SceneGraph* graph = scene_graph_new();
+    nodes[0]          = scene_graph_node_new(graph, NODE_NULL);
+
+    for (int i = 1; i < count; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[0]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 4096, rand() % (count / 4)});
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    return graph;
+}
+
+// Frame cost of the y-sort alone when movers nodes take a small step, as walking units do
+static double bench_frame(
+    SceneGraph* graph, ThreadPool* pool, const Node* nodes, int count, int movers) {
+    double samples[SAMPLES];
+
+    for (int s = 0; s < SAMPLES; s++) {
+        for (int i = 0; i < movers; i++) {
+            Node node  = nodes[1 + rand() % (count - 1)];
+            Position p = scene_graph_local_position_get(graph, node);
+            scene_graph_local_position_set(graph, node, (Position){p.x, p.y + rand() % 9 - 4});
+        }
+
+        scene_graph_compute_positions(graph);
+
+        double start = bench_now();
+        if (pool != NULL) {
+            scene_graph_ysort_parallel(graph, pool);
+        } else {
+            scene_graph_ysort(graph);
+        }
+        samples[s] = bench_now() - start;
+    }
+
+    return bench_median(samples, SAMPLES) * 1e6;
+}
+
+static void bench_ysort(int count, ThreadPool* pool) {
+    Node* nodes       = malloc(sizeof(Node) * count);
+    SceneGraph* graph = build_graph(nodes, count);
+
+    // Past a quarter of the nodes moving the sort falls back to sorting everything
+    const int movers[] = {0, 10, 100, 1000};
+    for (int m = 0; m < (int)(sizeof(movers) / sizeof(movers[0])); m++) {
+        printf("ysort nodes=%d movers=%d incremental_us=%.1f\n",
+               count,
+               movers[m],
+               bench_frame(graph, NULL, nodes, count, movers[m]));
+    }
+
+    double serial_us   = bench_frame(graph, NULL, nodes, count, count);
+    double parallel_us = bench_frame(graph, pool, nodes, count, count);
+    printf("ysort nodes=%d movers=%d full_us=%.1f full_parallel_us=%.1f\n", count, count, serial_us, parallel_us);
+
+    scene_graph_free(graph);
+    free(nodes);
+}
+
+int main(void) {
+    srand(42);
+    ThreadPool* pool = thread_pool_create(thread_pool_cpu_count() - 1);
+
+    bench_ysort(10000, pool);
+    bench_ysort(100000, pool);
+
+    thread_pool_destroy(pool);
+    return 0;
+}
@@ -1,18 +1,29 @@
 
 #include <float.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unity.h>
 
+#include "scene-graph/command-buffer.h"
 #include "scene-graph/graph-sort.h"
 #include "scene-graph/parallel-graph-sort.h"
+#include "scene-graph/parallel-transform.h"
+#include "scene-graph/present.h"
 #include "scene-graph/scene-graph.h"
+#include "scene-graph/snapshot.h"
+#include "thread-pool/thread-pool.h"
 
 void setUp() {
 }
 void tearDown() {
 }
 
+static Node drawn_node(SceneGraph* graph, int rank) {
+    return graph->node_handles[graph->draw_order[rank]];
+}
+
 static void simple_insert(void) {
     SceneGraph* graph = scene_graph_new();
     Node root         = scene_graph_node_new(graph, NODE_NULL);
@@ -21,7 +32,7 @@ static void simple_insert(void) {
     TEST_ASSERT_EQUAL_INT(0, root);
     TEST_ASSERT_EQUAL_INT(1, next);
 
-    free(graph);
+    scene_graph_free(graph);
 }
 
 static void simple_move(void) {
@@ -52,7 +63,7 @@ static void simple_move(void) {
 
     TEST_ASSERT_EQUAL_FLOAT(0.f, local_position.x);
     TEST_ASSERT_EQUAL_FLOAT(0.f, local_position.y);
-    free(graph);
+    scene_graph_free(graph);
 }
 
 static void graph_sorting(void) {
@@ -62,17 +73,21 @@ static void graph_sorting(void) {
     Node c1           = scene_graph_node_new(graph, root);
     Node c2           = scene_graph_node_new(graph, root);
 
-    TEST_ASSERT_EQUAL(graph->nodes[1].id, 1);
-    TEST_ASSERT_EQUAL(graph->nodes[2].id, 2);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 1), c1);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 2), c2);
 
     scene_graph_position_set(graph, c2, (Position){0, -10});
     scene_graph_compute_positions(graph);
     scene_graph_ysort(graph);
 
-    TEST_ASSERT_EQUAL(graph->nodes[1].id, 2);
-    TEST_ASSERT_EQUAL(graph->nodes[2].id, 1);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 1), c2);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 2), c1);
 
-    free(graph);
+    // Only the draw order changes, storage keeps its layout
+    TEST_ASSERT_EQUAL(graph->node_ids[1], c1);
+    TEST_ASSERT_EQUAL(graph->node_ids[2], c2);
+
+    scene_graph_free(graph);
 }
 
 static void graph_check_stable_sort(void) {
@@ -94,9 +109,9 @@ static void graph_check_stable_sort(void) {
     scene_graph_ysort(graph);
 
     // Verify that the relative order is maintained for equal y-values
-    TEST_ASSERT_EQUAL(graph->nodes[1].id, c1);
-    TEST_ASSERT_EQUAL(graph->nodes[2].id, c2);
-    TEST_ASSERT_EQUAL(graph->nodes[3].id, c3);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 1), c1);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 2), c2);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 3), c3);
 
     // Add nodes with distinct y-values
     Node c4 = scene_graph_node_new(graph, root);
@@ -104,21 +119,21 @@ static void graph_check_stable_sort(void) {
     scene_graph_position_set(graph, c4, (Position){0, 5});   // Higher y-value
     scene_graph_position_set(graph, c5, (Position){0, 15});  // Lower y-value
 
-    TEST_ASSERT_EQUAL(graph->nodes[4].id, c4);
-    TEST_ASSERT_EQUAL(graph->nodes[5].id, c5);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 4), c4);
+    TEST_ASSERT_EQUAL(drawn_node(graph, 5), c5);
 
     // Trigger sorting explicitly again
     scene_graph_compute_positions(graph);
     scene_graph_ysort(graph);
 
     // Verify sort order: c4 (y=15), c1/c2/c3 (y=10, stable order), c5 (y=5)
-    TEST_ASSERT_EQUAL(graph->nodes[1].id, c4);  // Highest y
-    TEST_ASSERT_EQUAL(graph->nodes[2].id, c1);  // First among equals
-    TEST_ASSERT_EQUAL(graph->nodes[3].id, c2);  // Second among equals
-    TEST_ASSERT_EQUAL(graph->nodes[4].id, c3);  // Third among equals
-    TEST_ASSERT_EQUAL(graph->nodes[5].id, c5);  // Lowest y
+    TEST_ASSERT_EQUAL(drawn_node(graph, 1), c4);  // Highest y
+    TEST_ASSERT_EQUAL(drawn_node(graph, 2), c1);  // First among equals
+    TEST_ASSERT_EQUAL(drawn_node(graph, 3), c2);  // Second among equals
+    TEST_ASSERT_EQUAL(drawn_node(graph, 4), c3);  // Third among equals
+    TEST_ASSERT_EQUAL(drawn_node(graph, 5), c5);  // Lowest y
 
-    free(graph);
+    scene_graph_free(graph);
 }
 
 static void move_parent_and_child_local(void) {
@@ -146,7 +161,35 @@ static void move_parent_and_child_local(void) {
     TEST_ASSERT_EQUAL_FLOAT(20.f, nl_pos.x);
     TEST_ASSERT_EQUAL_FLOAT(20.f, nl_pos.y);
 
-    free(graph);
+    scene_graph_free(graph);
+}
+
+static void coalesce_repeated_updates(void) {
+    SceneGraph* graph = scene_graph_new();
+
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node next         = scene_graph_node_new(graph, root);
+
+    scene_graph_position_set(graph, next, (Position){1, 1});
+    scene_graph_local_position_set(graph, next, (Position){2, 2});
+    scene_graph_position_set(graph, next, (Position){3, 3});
+    scene_graph_local_position_set(graph, root, (Position){10, 10});
+
+    TEST_ASSERT_EQUAL(2, graph->updated_nodes_count);
+
+    scene_graph_compute_positions(graph);
+
+    // The child's world write is resolved against the parent's new position
+    Position nw_pos = scene_graph_position_get(graph, next);
+    Position nl_pos = scene_graph_local_position_get(graph, next);
+
+    TEST_ASSERT_EQUAL(0, graph->updated_nodes_count);
+    TEST_ASSERT_EQUAL_FLOAT(3.f, nw_pos.x);
+    TEST_ASSERT_EQUAL_FLOAT(3.f, nw_pos.y);
+    TEST_ASSERT_EQUAL_FLOAT(-7.f, nl_pos.x);
+    TEST_ASSERT_EQUAL_FLOAT(-7.f, nl_pos.y);
+
+    scene_graph_free(graph);
 }
 
 static void delete_node_from_graph(void) {
@@ -164,13 +207,14 @@ static void delete_node_from_graph(void) {
 
     scene_graph_remove_destroyed_nodes(graph);
 
+    // Survivors keep their relative order
     for (int i = 1; i < 11; i++) {
-        int id = 21 - i;
+        int id = 10 + i;
 
-        TEST_ASSERT_EQUAL(id, graph->nodes[i].id);
+        TEST_ASSERT_EQUAL(id, graph->node_ids[i]);
     }
 
-    free(graph);
+    scene_graph_free(graph);
 }
 
 static void delete_node_with_game_object(void) {
@@ -196,14 +240,14 @@ static void delete_node_with_game_object(void) {
 
     for (int i = 0; i < 10; i++) {
         int id                = 20 - i;
-        int game_object_index = graph->game_object_indices[id];
+        int game_object_index = graph->game_object_indices[scene_graph_slot(id)];
 
         // +1 to avoid checking the root node
-        TEST_ASSERT_EQUAL(id, graph->nodes[i + 1].id);
+        TEST_ASSERT_EQUAL(11 + i, graph->node_ids[i + 1]);
         TEST_ASSERT_EQUAL(id, graph->game_objects[i].node);
     }
 
-    free(graph);
+    scene_graph_free(graph);
 }
 
 static void delete_node_with_drawable(void) {
@@ -223,15 +267,767 @@ static void delete_node_with_drawable(void) {
 
     scene_graph_remove_destroyed_nodes(graph);
 
+    // Survivors keep their draw order, the drawables array itself is packed by swapping
     for (int i = 0; i < 10; i++) {
-        int id = 20 - i;
-
         // +1 to avoid checking the root node
-        TEST_ASSERT_EQUAL(id, graph->nodes[i + 1].id);
-        TEST_ASSERT_EQUAL(id, graph->drawables[i].node);
+        TEST_ASSERT_EQUAL(11 + i, graph->node_ids[i + 1]);
+        TEST_ASSERT_EQUAL(11 + i, drawn_node(graph, i + 1));
+        TEST_ASSERT_EQUAL(20 - i, graph->drawables[i].node);
+    }
+
+    scene_graph_free(graph);
+}
+
+static void delete_subtree_keeps_parents_first(void) {
+    SceneGraph* graph = scene_graph_new();
+
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node a            = scene_graph_node_new(graph, root);
+    Node b            = scene_graph_node_new(graph, root);
+    Node a1           = scene_graph_node_new(graph, a);
+    Node b1           = scene_graph_node_new(graph, b);
+    Node a2           = scene_graph_node_new(graph, a1);
+    Node b2           = scene_graph_node_new(graph, b1);
+
+    scene_graph_node_destroy(graph, a);
+    scene_graph_remove_destroyed_nodes(graph);
+
+    // The whole subtree of a is gone and the rest is still stored parents first
+    TEST_ASSERT_EQUAL(4, graph->nodes_count);
+    TEST_ASSERT_EQUAL(NODE_NULL, scene_graph_index_get(graph, a1));
+    TEST_ASSERT_EQUAL(NODE_NULL, scene_graph_index_get(graph, a2));
+    for (int i = 1; i < graph->nodes_count; i++) {
+        TEST_ASSERT_LESS_THAN(i, graph->parent_indices[i]);
+    }
+
+    scene_graph_local_position_set(graph, root, (Position){1, 2});
+    scene_graph_local_position_set(graph, b1, (Position){10, 20});
+    scene_graph_position_set(graph, b2, (Position){100, 200});
+    scene_graph_compute_positions(graph);
+
+    Position b1_pos = scene_graph_position_get(graph, b1);
+    Position b2_pos = scene_graph_position_get(graph, b2);
+    Position b2_loc = scene_graph_local_position_get(graph, b2);
+
+    TEST_ASSERT_EQUAL_FLOAT(11.f, b1_pos.x);
+    TEST_ASSERT_EQUAL_FLOAT(22.f, b1_pos.y);
+    TEST_ASSERT_EQUAL_FLOAT(100.f, b2_pos.x);
+    TEST_ASSERT_EQUAL_FLOAT(200.f, b2_pos.y);
+    TEST_ASSERT_EQUAL_FLOAT(89.f, b2_loc.x);
+    TEST_ASSERT_EQUAL_FLOAT(178.f, b2_loc.y);
+
+    scene_graph_free(graph);
+}
+
+static void world_writes_resolve_deep_chains(void) {
+    const int depth   = 50000;
+    SceneGraph* graph = scene_graph_new();
+    Node node         = scene_graph_node_new(graph, NODE_NULL);
+    Node middle       = NODE_NULL;
+    for (int i = 1; i < depth; i++) {
+        node = scene_graph_node_new(graph, node);
+        scene_graph_local_position_set(graph, node, (Position){1, 2});
+        middle = i == depth / 2 ? node : middle;
+    }
+
+    // The root moves in the same frame, the write resolves against where it is going
+    scene_graph_local_position_set(graph, NODE_ROOT, (Position){5, 5});
+    scene_graph_position_set(graph, node, (Position){0, 0});
+    scene_graph_compute_positions(graph);
+
+    Position local = scene_graph_local_position_get(graph, node);
+    TEST_ASSERT_EQUAL_FLOAT(-(depth - 2) - 5, local.x);
+    TEST_ASSERT_EQUAL_FLOAT(-(depth - 2) * 2 - 5, local.y);
+    TEST_ASSERT_EQUAL_FLOAT(0, scene_graph_position_get(graph, node).x);
+    TEST_ASSERT_EQUAL_FLOAT(0, scene_graph_position_get(graph, node).y);
+
+    // Through the affine path a doubled ancestor halves what the leaf has to move locally
+    scene_graph_scale_set(graph, middle, (Scale){2, 2});
+    scene_graph_compute_positions(graph);
+    Position from = scene_graph_position_get(graph, node);
+    scene_graph_position_set(graph, node, (Position){from.x + 10, from.y});
+    scene_graph_compute_positions(graph);
+
+    TEST_ASSERT_FLOAT_WITHIN(1e-2, local.x + 5, scene_graph_local_position_get(graph, node).x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-1, from.x + 10, scene_graph_position_get(graph, node).x);
+
+    scene_graph_free(graph);
+}
+
+static Position expected_world_position(SceneGraph* graph, Node node) {
+    Node parent    = scene_graph_parent_get(graph, node);
+    Position local = scene_graph_local_position_get(graph, node);
+    if (parent == NODE_NULL) return local;
+
+    Position pw = expected_world_position(graph, parent);
+    return (Position){pw.x + local.x, pw.y + local.y};
+}
+
+static void assert_parents_first(SceneGraph* graph) {
+    for (int i = 1; i < graph->nodes_count; i++) {
+        int parent = graph->parent_indices[i];
+        TEST_ASSERT_LESS_THAN(i, parent);
+        TEST_ASSERT_EQUAL(scene_graph_index_get(graph, graph->nodes[i].parent), parent);
+    }
+}
+
+static void reparent_moves_subtree(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node a            = scene_graph_node_new(graph, root);
+    Node a_child      = scene_graph_node_new(graph, a);
+    Node b            = scene_graph_node_new(graph, root);
+    Node c            = scene_graph_node_new(graph, root);
+
+    scene_graph_local_position_set(graph, a, (Position){10, 0});
+    scene_graph_local_position_set(graph, a_child, (Position){1, 1});
+    scene_graph_local_position_set(graph, c, (Position){0, 100});
+    scene_graph_compute_positions(graph);
+
+    // c is stored after a, so the subtree has to move behind it
+    scene_graph_node_reparent(graph, a, c);
+    scene_graph_compute_positions(graph);
+    assert_parents_first(graph);
+
+    TEST_ASSERT_EQUAL(c, scene_graph_parent_get(graph, a));
+    TEST_ASSERT_EQUAL(b, scene_graph_first_child_get(graph, root));
+    TEST_ASSERT_EQUAL(c, scene_graph_last_child_get(graph, root));
+    TEST_ASSERT_EQUAL(NODE_NULL, scene_graph_prev_sibling_get(graph, b));
+    TEST_ASSERT_EQUAL(2, scene_graph_node_child_count(graph, root));
+    TEST_ASSERT_EQUAL(1, scene_graph_node_child_count(graph, c));
+
+    Position position = scene_graph_position_get(graph, a_child);
+    TEST_ASSERT_EQUAL_FLOAT(11, position.x);
+    TEST_ASSERT_EQUAL_FLOAT(101, position.y);
+
+    // Detaching keeps the world position but drops the parent's offset from the local one
+    scene_graph_node_detach(graph, a_child);
+    scene_graph_compute_positions(graph);
+    assert_parents_first(graph);
+
+    position = scene_graph_position_get(graph, a_child);
+    TEST_ASSERT_EQUAL(root, scene_graph_parent_get(graph, a_child));
+    TEST_ASSERT_EQUAL(a_child, scene_graph_last_child_get(graph, root));
+    TEST_ASSERT_EQUAL(0, scene_graph_node_child_count(graph, a));
+    TEST_ASSERT_EQUAL_FLOAT(11, position.x);
+    TEST_ASSERT_EQUAL_FLOAT(101, position.y);
+
+    scene_graph_free(graph);
+}
+
+static void reparents_relayout_once(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node nodes[8];
+    for (int i = 0; i < 8; i++) {
+        nodes[i] = scene_graph_node_new(graph, root);
+        scene_graph_local_position_set(graph, nodes[i], (Position){i, 1});
+    }
+
+    scene_graph_compute_positions(graph);
+
+    // Chained under later nodes, the middle of the chain is itself moved after it is taken
+    scene_graph_node_reparent(graph, nodes[0], nodes[5]);
+    scene_graph_node_reparent(graph, nodes[5], nodes[7]);
+    scene_graph_node_reparent(graph, nodes[2], nodes[0]);
+    scene_graph_node_reparent(graph, nodes[3], nodes[1]);
+    TEST_ASSERT_TRUE(graph->relayout);
+
+    // Storage is only touched once, by the first pass that needs it parents first
+    int version = graph->layout_version;
+    scene_graph_compute_positions(graph);
+    TEST_ASSERT_FALSE(graph->relayout);
+    TEST_ASSERT_EQUAL(version + 1, graph->layout_version);
+    assert_parents_first(graph);
+
+    // Untouched nodes keep their order, the moved ones follow in the order of their tops
+    TEST_ASSERT_EQUAL(nodes[1], graph->node_ids[1]);
+    TEST_ASSERT_EQUAL(nodes[3], graph->node_ids[2]);
+    TEST_ASSERT_EQUAL(nodes[4], graph->node_ids[3]);
+    TEST_ASSERT_EQUAL(nodes[7], graph->node_ids[5]);
+
+    Position position = scene_graph_position_get(graph, nodes[2]);
+    TEST_ASSERT_EQUAL_FLOAT(0 + 5 + 7 + 2, position.x);
+    TEST_ASSERT_EQUAL_FLOAT(4, position.y);
+
+    // Destruction needs parents first as well and relayouts on its own
+    scene_graph_node_reparent(graph, nodes[1], nodes[7]);
+    scene_graph_node_destroy(graph, nodes[7]);
+    scene_graph_remove_destroyed_nodes(graph);
+    assert_parents_first(graph);
+    TEST_ASSERT_EQUAL(3, graph->nodes_count);
+
+    scene_graph_free(graph);
+}
+
+static void destroy_squad_unlinks_from_parent(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node first        = scene_graph_node_new(graph, root);
+    Node squad[500];
+
+    for (int i = 0; i < 500; i++) {
+        squad[i] = scene_graph_node_new(graph, root);
+        scene_graph_node_new(graph, squad[i]);
+    }
+
+    Node last = scene_graph_node_new(graph, root);
+
+    for (int i = 0; i < 500; i++) {
+        scene_graph_node_destroy(graph, squad[i]);
+    }
+
+    scene_graph_remove_destroyed_nodes(graph);
+    assert_parents_first(graph);
+
+    // The squad and everything under it is gone, the surviving siblings are linked directly
+    TEST_ASSERT_EQUAL(3, graph->nodes_count);
+    TEST_ASSERT_EQUAL(2, scene_graph_node_child_count(graph, root));
+    TEST_ASSERT_EQUAL(first, scene_graph_first_child_get(graph, root));
+    TEST_ASSERT_EQUAL(last, scene_graph_sibling_get(graph, first));
+    TEST_ASSERT_EQUAL(first, scene_graph_prev_sibling_get(graph, last));
+    TEST_ASSERT_EQUAL(last, scene_graph_last_child_get(graph, root));
+
+    scene_graph_free(graph);
+}
+
+static void stale_handle_does_not_alias(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node stale        = scene_graph_node_new(graph, root);
+
+    scene_graph_local_position_set(graph, stale, (Position){5, 5});
+    scene_graph_node_destroy(graph, stale);
+    scene_graph_remove_destroyed_nodes(graph);
+
+    // The freed slot is reused right away, under a new generation
+    Node fresh = scene_graph_node_new(graph, root);
+    TEST_ASSERT_EQUAL(scene_graph_slot(stale), scene_graph_slot(fresh));
+    TEST_ASSERT_NOT_EQUAL(stale, fresh);
+    TEST_ASSERT_FALSE(scene_graph_node_valid(graph, stale));
+    TEST_ASSERT_TRUE(scene_graph_node_valid(graph, fresh));
+    TEST_ASSERT_EQUAL(NODE_NULL, scene_graph_index_get(graph, stale));
+
+    // Writes through the old handle, queued before or after the reuse, never reach the new node
+    scene_graph_local_position_set(graph, fresh, (Position){1, 2});
+    scene_graph_local_position_set(graph, stale, (Position){100, 100});
+    scene_graph_compute_positions(graph);
+
+    Position position = scene_graph_position_get(graph, fresh);
+    TEST_ASSERT_EQUAL_FLOAT(1, position.x);
+    TEST_ASSERT_EQUAL_FLOAT(2, position.y);
+
+    // Direct setters return early on the old handle, the new node keeps its layer and position
+    scene_graph_layer_set(graph, fresh, 1);
+    int queued = graph->sort_queue_count;
+    TEST_ASSERT_EQUAL(NODE_NULL, scene_graph_layer_set(graph, stale, 3));
+    scene_graph_parent_set(graph, stale, stale);
+    TEST_ASSERT_EQUAL(queued, graph->sort_queue_count);
+    TEST_ASSERT_EQUAL(1, scene_graph_layer_get(graph, fresh));
+    TEST_ASSERT_EQUAL(root, scene_graph_parent_get(graph, fresh));
+
+    scene_graph_compute_positions(graph);
+    position = scene_graph_position_get(graph, fresh);
+    TEST_ASSERT_EQUAL_FLOAT(1, position.x);
+    TEST_ASSERT_EQUAL_FLOAT(2, position.y);
+
+    scene_graph_free(graph);
+}
+
+typedef struct RecordJob {
+    SceneCommandBuffer* buffer;
+    Node parent;
+    int seed;
+} RecordJob;
+
+static void record_commands(void* arg) {
+    RecordJob* job = arg;
+    Node squad     = scene_command_node_new(job->buffer, job->parent);
+    scene_command_local_position_set(job->buffer, squad, (Position){job->seed * 10.0f, 0});
+
+    for (int i = 0; i < 100; i++) {
+        Node member = scene_command_node_new(job->buffer, squad);
+        scene_command_local_position_set(job->buffer, member, (Position){i, job->seed});
+        scene_command_layer_set(job->buffer, member, i % 3);
+        if (i % 10 == 0) scene_command_node_destroy(job->buffer, member);
+    }
+
+    scene_command_position_set(job->buffer, job->parent, (Position){1, 1});
+}
+
+static void command_buffers_apply_in_order(void) {
+    ThreadPool* pool    = thread_pool_create(4);
+    Position* reference = NULL;
+
+    // Recording races between the workers, the flushed result must not
+    for (int run = 0; run < 2; run++) {
+        SceneGraph* graph = scene_graph_new();
+        Node root         = scene_graph_node_new(graph, NODE_NULL);
+        Node parent       = scene_graph_node_new(graph, root);
+
+        SceneCommandBuffer* buffers[4];
+        RecordJob jobs[4];
+        JobCounter counter = {0};
+        scene_graph_slots_reserve(graph, 4 * 101);
+        for (int i = 0; i < 4; i++) {
+            buffers[i] = scene_command_buffer_new(graph);
+            jobs[i]    = (RecordJob){.buffer = buffers[i], .parent = parent, .seed = i};
+            thread_pool_run(pool, record_commands, &jobs[i], &counter);
+        }
+
+        thread_pool_wait(pool, &counter);
+        scene_command_buffers_flush(buffers, 4);
+        scene_graph_remove_destroyed_nodes(graph);
+        scene_graph_compute_positions(graph);
+
+        TEST_ASSERT_EQUAL(2 + 4 * 91, graph->nodes_count);
+        TEST_ASSERT_EQUAL(4, scene_graph_node_child_count(graph, parent));
+        assert_parents_first(graph);
+
+        Position position = scene_graph_position_get(graph, parent);
+        TEST_ASSERT_EQUAL_FLOAT(1, position.x);
+
+        if (reference == NULL) {
+            reference = malloc(sizeof(Position) * graph->nodes_count);
+            memcpy(reference, graph->world_positions, sizeof(Position) * graph->nodes_count);
+        } else {
+            TEST_ASSERT_EQUAL_MEMORY(reference, graph->world_positions, sizeof(Position) * graph->nodes_count);
+        }
+
+        for (int i = 0; i < 4; i++) {
+            TEST_ASSERT_EQUAL(0, buffers[i]->commands_count);
+            scene_command_buffer_free(buffers[i]);
+        }
+
+        scene_graph_free(graph);
+    }
+
+    free(reference);
+    thread_pool_destroy(pool);
+}
+
+static void command_buffers_drop_missing_parents(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node parent       = scene_graph_node_new(graph, root);
+    Node stray        = scene_graph_node_new(graph, root);
+    scene_graph_slots_reserve(graph, 8);
+    const int free    = graph->free_slots_count;
+
+    SceneCommandBuffer* buffers[2] = {scene_command_buffer_new(graph), scene_command_buffer_new(graph)};
+
+    // Buffer 0 destroys the parent while buffer 1 creates under it, the child dies with it
+    scene_command_node_destroy(buffers[0], parent);
+    Node doomed = scene_command_node_new(buffers[1], parent);
+    scene_command_buffers_flush(buffers, 2);
+    scene_graph_remove_destroyed_nodes(graph);
+    TEST_ASSERT_FALSE(scene_graph_node_valid(graph, doomed));
+    TEST_ASSERT_EQUAL(2, graph->nodes_count);
+
+    // Removed before the flush, the parent handle is stale by the time the create applies
+    parent      = scene_graph_node_new(graph, root);
+    Node orphan = scene_command_node_new(buffers[1], parent);
+    scene_command_local_position_set(buffers[1], orphan, (Position){1, 1});
+    scene_command_node_reparent(buffers[1], stray, parent);
+    scene_graph_node_destroy(graph, parent);
+    scene_graph_remove_destroyed_nodes(graph);
+    scene_command_buffers_flush(buffers, 2);
+    TEST_ASSERT_FALSE(scene_graph_node_valid(graph, orphan));
+    TEST_ASSERT_EQUAL(root, scene_graph_parent_get(graph, stray));
+
+    // A parent from a later buffer is not inserted yet when buffer 0 applies
+    Node squad  = scene_command_node_new(buffers[1], root);
+    Node member = scene_command_node_new(buffers[0], squad);
+    scene_command_buffers_flush(buffers, 2);
+    TEST_ASSERT_TRUE(scene_graph_index_get(graph, squad) != NODE_NULL);
+    TEST_ASSERT_FALSE(scene_graph_node_valid(graph, member));
+    TEST_ASSERT_EQUAL(3, graph->nodes_count);
+    assert_parents_first(graph);
+
+    // Every dropped create gave its slot back, and so does a buffer freed before its flush
+    TEST_ASSERT_EQUAL(free, graph->free_slots_count);
+    scene_command_node_new(buffers[0], root);
+    scene_command_buffer_free(buffers[0]);
+    scene_command_buffer_free(buffers[1]);
+    TEST_ASSERT_EQUAL(free, graph->free_slots_count);
+
+    scene_graph_free(graph);
+}
+
+static void transform_kernel_matches_scalar(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node nodes[1000];
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+
+    srand(1234);
+    for (int i = 1; i < 1000; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[rand() % i]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 97, rand() % 89});
+    }
+
+    // Full rebuild, then a sparse dirty update on top of it
+    for (int pass = 0; pass < 2; pass++) {
+        scene_graph_compute_positions(graph);
+
+        for (int i = 0; i < 1000; i++) {
+            Position actual   = scene_graph_position_get(graph, nodes[i]);
+            Position expected = expected_world_position(graph, nodes[i]);
+            TEST_ASSERT_EQUAL_MEMORY(&expected, &actual, sizeof(Position));
+        }
+
+        for (int i = 0; i < 10; i++) {
+            Node node = nodes[1 + rand() % 999];
+            scene_graph_local_position_set(graph, node, (Position){rand() % 31, rand() % 37});
+        }
+    }
+
+    scene_graph_free(graph);
+}
+
+static void rotated_parent_carries_child(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node player       = scene_graph_node_new(graph, root);
+    Node weapon       = scene_graph_node_new(graph, player);
+
+    scene_graph_local_position_set(graph, player, (Position){100, 50});
+    scene_graph_local_position_set(graph, weapon, (Position){10, 0});
+    scene_graph_rotation_set(graph, player, 1.57079632679f);
+    scene_graph_scale_set(graph, player, (Scale){2, 2});
+    scene_graph_compute_positions(graph);
+
+    // A quarter turn and double scale puts the weapon 20 units below the player
+    Position position = scene_graph_position_get(graph, weapon);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 100, position.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 70, position.y);
+
+    Transform2D transform = scene_graph_transform_get(graph, weapon);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, transform.a);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 2, transform.b);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, -2, transform.c);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, transform.d);
+
+    // World writes are mapped back through the rotated parent
+    scene_graph_position_set(graph, weapon, (Position){80, 50});
+    scene_graph_compute_positions(graph);
+    Position local = scene_graph_local_position_get(graph, weapon);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, local.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 10, local.y);
+    position = scene_graph_position_get(graph, weapon);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 80, position.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 50, position.y);
+
+    // Under a parent scaled to zero the write is kept as an offset and shows once it grows back
+    scene_graph_scale_set(graph, player, (Scale){0, 0});
+    scene_graph_compute_positions(graph);
+    scene_graph_position_set(graph, weapon, (Position){90, 60});
+    scene_graph_compute_positions(graph);
+    local = scene_graph_local_position_get(graph, weapon);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, -10, local.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 10, local.y);
+    position = scene_graph_position_get(graph, weapon);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 100, position.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 50, position.y);
+
+    scene_graph_rotation_set(graph, player, 0);
+    scene_graph_scale_set(graph, player, (Scale){1, 1});
+    scene_graph_compute_positions(graph);
+    position = scene_graph_position_get(graph, weapon);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 90, position.x);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 60, position.y);
+
+    scene_graph_free(graph);
+}
+
+static void translation_only_after_reset(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node nodes[200];
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+
+    srand(4321);
+    for (int i = 1; i < 200; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[rand() % i]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 97, rand() % 89});
+    }
+
+    // Rotating and un-rotating a node leaves results identical to the translation kernel
+    scene_graph_rotation_set(graph, nodes[1], 0.5f);
+    scene_graph_compute_positions(graph);
+    TEST_ASSERT_TRUE(graph->affine);
+
+    scene_graph_rotation_set(graph, nodes[1], 0.0f);
+    scene_graph_compute_positions(graph);
+    TEST_ASSERT_FALSE(graph->affine);
+
+    for (int i = 0; i < 200; i++) {
+        Position actual       = scene_graph_position_get(graph, nodes[i]);
+        Position expected     = expected_world_position(graph, nodes[i]);
+        Transform2D transform = scene_graph_transform_get(graph, nodes[i]);
+        TEST_ASSERT_EQUAL_MEMORY(&expected, &actual, sizeof(Position));
+        TEST_ASSERT_EQUAL_FLOAT(1, transform.a);
+        TEST_ASSERT_EQUAL_FLOAT(0, transform.b);
+    }
+
+    scene_graph_free(graph);
+}
+
+static void random_hierarchy(SceneGraph* graph, Node* nodes, int count, unsigned seed) {
+    srand(seed);
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        // A few dozen top-level subtrees, then random parents so subtrees interleave in storage
+        Node parent = i < 64 ? nodes[0] : nodes[rand() % i];
+        nodes[i]    = scene_graph_node_new(graph, parent);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 97 * 0.1f, rand() % 89 * 0.3f});
+    }
+}
+
+static void parallel_matches_serial(void) {
+    const int count = SCENE_GRAPH_PARALLEL_THRESHOLD + 4000;
+    Node* serial    = malloc(sizeof(Node) * count);
+    Node* parallel  = malloc(sizeof(Node) * count);
+    ThreadPool* pool = thread_pool_create(4);
+
+    for (unsigned seed = 1; seed <= 3; seed++) {
+        SceneGraph* a = scene_graph_new();
+        SceneGraph* b = scene_graph_new();
+        random_hierarchy(a, serial, count, seed);
+        random_hierarchy(b, parallel, count, seed);
+
+        // Full build, sparse moves, then rotation and scale on a handful of nodes
+        for (int pass = 0; pass < 3; pass++) {
+            scene_graph_compute_positions(a);
+            scene_graph_compute_positions_parallel(b, pool);
+
+            TEST_ASSERT_EQUAL(a->nodes_count, b->nodes_count);
+            TEST_ASSERT_EQUAL_MEMORY(a->world_positions, b->world_positions, sizeof(Position) * count);
+            for (int i = 0; i < count; i++) {
+                Transform2D ta = scene_graph_transform_get(a, serial[i]);
+                Transform2D tb = scene_graph_transform_get(b, parallel[i]);
+                TEST_ASSERT_EQUAL_MEMORY(&ta, &tb, sizeof(Transform2D));
+            }
+
+            for (int i = 0; i < 100; i++) {
+                int index  = 1 + rand() % (count - 1);
+                Position p = {rand() % 31, rand() % 37};
+                float r    = (rand() % 628) * 0.01f;
+                scene_graph_local_position_set(a, serial[index], p);
+                scene_graph_local_position_set(b, parallel[index], p);
+
+                if (pass == 1 && i % 10 == 0) {
+                    scene_graph_rotation_set(a, serial[index], r);
+                    scene_graph_rotation_set(b, parallel[index], r);
+                    scene_graph_scale_set(a, serial[index], (Scale){0.5f, 2});
+                    scene_graph_scale_set(b, parallel[index], (Scale){0.5f, 2});
+                }
+            }
+        }
+
+        scene_graph_free(a);
+        scene_graph_free(b);
+    }
+
+    thread_pool_destroy(pool);
+    free(parallel);
+    free(serial);
+}
+
+static void grow_past_initial_capacity(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+
+    TEST_ASSERT_EQUAL(SCENE_GRAPH_PAGE_SIZE, graph->capacity);
+
+    // Deliberately more than the old fixed limit of 32768 nodes
+    Node last = root;
+    for (int i = 0; i < 40000; i++) {
+        last = scene_graph_node_new(graph, root);
+    }
+
+    TEST_ASSERT_EQUAL(40001, graph->nodes_count);
+    TEST_ASSERT_GREATER_OR_EQUAL(40001, graph->capacity);
+
+    scene_graph_local_position_set(graph, last, (Position){5, 7});
+    scene_graph_compute_positions(graph);
+
+    Position position = scene_graph_position_get(graph, last);
+    TEST_ASSERT_EQUAL_FLOAT(5.f, position.x);
+    TEST_ASSERT_EQUAL_FLOAT(7.f, position.y);
+
+    scene_graph_free(graph);
+}
+
+static int drawn[4096];
+static int drawn_count;
+
+static void record_draw(const Drawable* drawable, const Transform2D* transform) {
+    drawn[drawn_count++] = drawable->node;
+}
+
+static int drawn_rank(SceneGraph* graph, int i) {
+    return graph->draw_ranks[scene_graph_slot(drawn[i])];
+}
+
+static int visible_brute_force(SceneGraph* graph, Bounds view) {
+    int visible = 0;
+    for (int i = 0; i < graph->drawables_count; i++) {
+        Position p = scene_graph_position_get(graph, graph->drawables[i].node);
+        Bounds b   = graph->drawables[i].bounds;
+        if (p.x + b.x <= view.x + view.width && p.x + b.x + b.width >= view.x &&
+            p.y + b.y <= view.y + view.height && p.y + b.y + b.height >= view.y) {
+            visible++;
+        }
+    }
+
+    return visible;
+}
+
+static void render_view_culls_offscreen(void) {
+    const int count   = 2000;
+    Node nodes[2000]  = {0};
+    SceneGraph* graph = scene_graph_new();
+    Bounds view       = {100, 50, 640, 360};
+
+    srand(7);
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[rand() % i]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 200 - 60, rand() % 120 - 30});
+
+        Drawable* drawable = scene_graph_drawable_new(graph, nodes[i]);
+        drawable->draw     = record_draw;
+        scene_graph_drawable_bounds_set(graph, nodes[i], (Bounds){-4, -4, 8 + i % 24, 8});
+    }
+
+    // Wider than a cell, then back to a small entry after the first pass
+    scene_graph_drawable_bounds_set(graph, nodes[count - 1], (Bounds){-600, -4, 1200, 8});
+
+    for (int pass = 0; pass < 3; pass++) {
+        scene_graph_compute_positions(graph);
+
+        drawn_count = 0;
+        scene_graph_render_view(graph, view);
+
+        int expected = visible_brute_force(graph, view);
+        TEST_ASSERT_GREATER_THAN(0, expected);
+        TEST_ASSERT_LESS_THAN(graph->drawables_count, expected);
+        TEST_ASSERT_EQUAL(expected, drawn_count);
+
+        // Culling must not change the draw order the sort produced
+        for (int i = 1; i < drawn_count; i++) {
+            TEST_ASSERT_LESS_THAN(drawn_rank(graph, i), drawn_rank(graph, i - 1));
+        }
+
+        for (int i = 0; i < 200; i++) {
+            Node node = nodes[1 + rand() % (count - 1)];
+            if (scene_graph_node_valid(graph, node)) {
+                scene_graph_local_position_set(graph, node, (Position){rand() % 400 - 200, rand() % 300 - 150});
+            }
+        }
+
+        if (scene_graph_node_valid(graph, nodes[count - 1])) {
+            scene_graph_drawable_bounds_set(graph, nodes[count - 1], (Bounds){-4, -4, 8, 8});
+        }
+
+        scene_graph_node_destroy(graph, nodes[1 + pass * 7]);
+        scene_graph_remove_destroyed_nodes(graph);
     }
 
-    free(graph);
+    scene_graph_free(graph);
+}
+
+// Every sibling list is sorted and the draw order is exactly the preorder walk of the lists
+static void assert_ysorted(SceneGraph* graph) {
+    int rank  = 0;
+    Node node = NODE_ROOT;
+    while (node != NODE_NULL) {
+        TEST_ASSERT_EQUAL(node, drawn_node(graph, rank));
+        TEST_ASSERT_EQUAL(rank++, graph->draw_ranks[scene_graph_slot(node)]);
+
+        Node prev = scene_graph_node_get(graph, node)->prev_sibling;
+        if (prev != NODE_NULL) {
+            int a = scene_graph_index_get(graph, prev);
+            int b = scene_graph_index_get(graph, node);
+            TEST_ASSERT_LESS_OR_EQUAL(graph->nodes[b].layer, graph->nodes[a].layer);
+            if (graph->nodes[a].layer == graph->nodes[b].layer) {
+                TEST_ASSERT_LESS_OR_EQUAL(graph->world_positions[b].y, graph->world_positions[a].y);
+            }
+        }
+
+        if (scene_graph_first_child_get(graph, node) != NODE_NULL) {
+            node = scene_graph_first_child_get(graph, node);
+            continue;
+        }
+
+        while (node != NODE_NULL && scene_graph_sibling_get(graph, node) == NODE_NULL) {
+            node = scene_graph_parent_get(graph, node);
+        }
+
+        node = node != NODE_NULL ? scene_graph_sibling_get(graph, node) : NODE_NULL;
+    }
+
+    TEST_ASSERT_EQUAL(graph->nodes_count, rank);
+    assert_parents_first(graph);
+}
+
+static void incremental_ysort_repairs_movers(void) {
+    const int count   = 3000;
+    Node nodes[3000]  = {0};
+    SceneGraph* graph = scene_graph_new();
+
+    srand(11);
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        // Mostly root children like sprites, with some nested squads
+        Node parent = i < 2000 ? nodes[0] : nodes[1 + rand() % (i - 1)];
+        nodes[i]    = scene_graph_node_new(graph, parent);
+        scene_graph_local_position_set(graph, nodes[i], (Position){0, rand() % 500});
+        scene_graph_drawable_new(graph, nodes[i]);
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    assert_ysorted(graph);
+
+    for (int frame = 0; frame < 20; frame++) {
+        for (int i = 0; i < 40; i++) {
+            Node node = nodes[1 + rand() % (count - 1)];
+            if (!scene_graph_node_valid(graph, node)) continue;
+
+            Position p = scene_graph_local_position_get(graph, node);
+            scene_graph_local_position_set(graph, node, (Position){p.x, p.y + rand() % 41 - 20});
+        }
+
+        // Spawning under the root and destroying both keep the draw order a preorder
+        int spawned    = 1 + rand() % (count - 1);
+        Node destroyed = nodes[1 + rand() % (count - 1)];
+        if (scene_graph_node_valid(graph, destroyed)) {
+            scene_graph_node_destroy(graph, destroyed);
+            scene_graph_remove_destroyed_nodes(graph);
+        }
+
+        if (!scene_graph_node_valid(graph, nodes[spawned])) {
+            nodes[spawned] = scene_graph_node_new(graph, nodes[0]);
+            scene_graph_local_position_set(graph, nodes[spawned], (Position){0, rand() % 500});
+        }
+
+        if (frame % 5 == 0) {
+            Node node = nodes[1 + rand() % (count - 1)];
+            if (scene_graph_node_valid(graph, node)) {
+                scene_graph_layer_set(graph, node, 1);
+            }
+        }
+
+        scene_graph_compute_positions(graph);
+        TEST_ASSERT_TRUE(graph->preordered);
+        TEST_ASSERT_LESS_OR_EQUAL(count / 4, graph->sort_queue_count);
+
+        scene_graph_ysort(graph);
+        TEST_ASSERT_EQUAL(0, graph->sort_queue_count);
+        assert_ysorted(graph);
+    }
+
+    scene_graph_free(graph);
 }
 
 static void test_order_of_sorting(void) {
@@ -249,13 +1045,686 @@ static void test_order_of_sorting(void) {
     scene_graph_compute_positions(graph);
     scene_graph_ysort_parallel(graph, NULL);
 
-    float position = FLT_MIN;
+    // +1 to skip the root node
+    float position = -FLT_MAX;
     for (int i = 0; i < 100; i++) {
-        float posY = scene_graph_position_get(graph, children[i]).y;
-        printf("%f - %f\n", position, posY);
+        float posY = scene_graph_position_get(graph, drawn_node(graph, i + 1)).y;
         TEST_ASSERT_GREATER_OR_EQUAL(position, posY);
         position = posY;
     }
+
+    scene_graph_free(graph);
+}
+
+static void build_sort_graph(SceneGraph* graph, int count, unsigned seed) {
+    srand(seed);
+    Node root = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        // One parent far above the split threshold, then squads, with ties, negative y and layers
+        Node parent = i < count / 2 ? root : graph->node_ids[1 + rand() % (i - 1)];
+        Node node   = scene_graph_node_new(graph, parent);
+        scene_graph_local_position_set(graph, node, (Position){0, rand() % 300 - 150 + 0.5f * (rand() % 2)});
+        if (rand() % 7 == 0) {
+            scene_graph_layer_set(graph, node, rand() % 3);
+        }
+    }
+
+    scene_graph_compute_positions(graph);
+}
+
+static void radix_ysort_matches_serial(void) {
+    const int count  = 2 * SCENE_GRAPH_YSORT_SPLIT + 5000;
+    ThreadPool* pool = thread_pool_create(4);
+
+    SceneGraph* serial   = scene_graph_new();
+    SceneGraph* parallel = scene_graph_new();
+    SceneGraph* inline_  = scene_graph_new();
+    build_sort_graph(serial, count, 5);
+    build_sort_graph(parallel, count, 5);
+    build_sort_graph(inline_, count, 5);
+
+    // Both sorts are stable over the same starting lists, so the orders must match exactly
+    scene_graph_ysort(serial);
+    scene_graph_ysort_parallel(parallel, pool);
+    scene_graph_ysort_parallel(inline_, NULL);
+    assert_ysorted(parallel);
+
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(serial->draw_order[i], parallel->draw_order[i]);
+        TEST_ASSERT_EQUAL(serial->draw_order[i], inline_->draw_order[i]);
+    }
+
+    scene_graph_free(inline_);
+    scene_graph_free(parallel);
+    scene_graph_free(serial);
+    thread_pool_destroy(pool);
+}
+
+static void render_follows_draw_order(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node children[50];
+
+    for (int i = 0; i < 50; i++) {
+        children[i]        = scene_graph_node_new(graph, root);
+        Drawable* drawable = scene_graph_drawable_new(graph, children[i]);
+        drawable->draw     = record_draw;
+        scene_graph_position_set(graph, children[i], (Position){0, 50 - i});
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort_parallel(graph, NULL);
+
+    // Sorting reversed the draw order without moving storage or drawables
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_EQUAL(children[i], graph->node_ids[i + 1]);
+        TEST_ASSERT_EQUAL(children[i], graph->drawables[i].node);
+        TEST_ASSERT_EQUAL(children[49 - i], drawn_node(graph, i + 1));
+    }
+
+    drawn_count = 0;
+    scene_graph_render(graph);
+    TEST_ASSERT_EQUAL(50, drawn_count);
+    for (int i = 0; i < 50; i++) {
+        TEST_ASSERT_EQUAL(i + 1, drawn_rank(graph, i));
+    }
+
+    scene_graph_free(graph);
+}
+
+// Layers draw in ascending order, y-sorted layers by world y and static layers in the order added
+static void assert_layered(SceneGraph* graph) {
+    for (int i = 1; i < drawn_count; i++) {
+        int a = scene_graph_layer_get(graph, drawn[i - 1]);
+        int b = scene_graph_layer_get(graph, drawn[i]);
+        TEST_ASSERT_LESS_OR_EQUAL(b, a);
+        if (a != b) continue;
+
+        if (graph->layer_ysort[a]) {
+            float ay = scene_graph_position_get(graph, drawn[i - 1]).y;
+            float by = scene_graph_position_get(graph, drawn[i]).y;
+            TEST_ASSERT_LESS_OR_EQUAL(by, ay);
+        } else {
+            uint32_t as = graph->sequences[scene_graph_slot(drawn[i - 1])];
+            uint32_t bs = graph->sequences[scene_graph_slot(drawn[i])];
+            TEST_ASSERT_TRUE(as < bs);
+        }
+    }
+}
+
+static void render_layers_bucket_drawables(void) {
+    const int count   = 600;
+    Node nodes[600]   = {0};
+    SceneGraph* graph = scene_graph_new();
+    Bounds view       = {-1000, -1000, 3000, 3000};
+
+    srand(13);
+    scene_graph_layer_ysort_set(graph, 1, false);
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[0]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 500, rand() % 500});
+        scene_graph_layer_set(graph, nodes[i], rand() % 3);
+
+        Drawable* drawable = scene_graph_drawable_new(graph, nodes[i]);
+        drawable->draw     = record_draw;
+    }
+
+    for (int frame = 0; frame < 4; frame++) {
+        scene_graph_compute_positions(graph);
+        scene_graph_ysort(graph);
+
+        drawn_count = 0;
+        scene_graph_render(graph);
+        TEST_ASSERT_EQUAL(graph->drawables_count, drawn_count);
+        assert_layered(graph);
+
+        // Culling keeps the layered order
+        int rendered[600];
+        memcpy(rendered, drawn, sizeof(int) * drawn_count);
+        drawn_count = 0;
+        scene_graph_render_view(graph, view);
+        TEST_ASSERT_EQUAL_INT_ARRAY(rendered, drawn, drawn_count);
+
+        // Moving a node on a static layer never queues it for the y-sort
+        for (int i = 1; i < count; i++) {
+            if (scene_graph_node_valid(graph, nodes[i]) && scene_graph_layer_get(graph, nodes[i]) == 1) {
+                scene_graph_local_position_set(graph, nodes[i], (Position){0, rand() % 500 + 600});
+                break;
+            }
+        }
+
+        scene_graph_compute_positions(graph);
+        TEST_ASSERT_EQUAL(0, graph->sort_queue_count);
+
+        for (int i = 0; i < 60; i++) {
+            Node node = nodes[1 + rand() % (count - 1)];
+            if (!scene_graph_node_valid(graph, node)) continue;
+
+            scene_graph_local_position_set(graph, node, (Position){rand() % 500, rand() % 500});
+            if (i % 10 == 0) {
+                scene_graph_layer_set(graph, node, rand() % 3);
+            }
+        }
+
+        scene_graph_node_destroy(graph, nodes[1 + frame * 5]);
+        scene_graph_remove_destroyed_nodes(graph);
+    }
+
+    scene_graph_free(graph);
+}
+
+static void assert_drawn_in_order(const Node* nodes, int count) {
+    TEST_ASSERT_TRUE(drawn_count >= count);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(nodes[i], drawn[i]);
+    }
+}
+
+static void static_layers_keep_creation_order(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node decals[6];
+    Node root = scene_graph_node_new(graph, NODE_NULL);
+
+    // Decals climb up the screen as they are added, a y-sort would draw them backwards
+    scene_graph_layer_ysort_set(graph, 0, false);
+    for (int i = 0; i < 6; i++) {
+        decals[i]          = scene_graph_node_new(graph, root);
+        Drawable* drawable = scene_graph_drawable_new(graph, decals[i]);
+        drawable->draw     = record_draw;
+        scene_graph_local_position_set(graph, decals[i], (Position){i, 100 - i * 10});
+    }
+
+    Node holder        = scene_graph_node_new(graph, root);
+    Drawable* drawable = scene_graph_drawable_new(graph, holder);
+    drawable->draw     = record_draw;
+    scene_graph_layer_set(graph, holder, 1);
+    scene_graph_local_position_set(graph, holder, (Position){0, 500});
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    drawn_count = 0;
+    scene_graph_render(graph);
+    assert_drawn_in_order(decals, 6);
+
+    // Full sorts order static siblings by creation as well, not by y
+    for (int i = 1; i < 6; i++) {
+        TEST_ASSERT_TRUE(graph->draw_ranks[scene_graph_slot(decals[i - 1])] <
+                         graph->draw_ranks[scene_graph_slot(decals[i])]);
+    }
+
+    // The holder is stored after the decals, adopting one moves it to the back of storage
+    scene_graph_node_reparent(graph, decals[1], holder);
+    scene_graph_node_reparent(graph, decals[3], holder);
+    scene_graph_compute_positions(graph);
+    TEST_ASSERT_EQUAL(graph->nodes_count - 1, scene_graph_index_get(graph, decals[3]));
+
+    scene_graph_ysort(graph);
+    drawn_count = 0;
+    scene_graph_render(graph);
+    assert_drawn_in_order(decals, 6);
+
+    drawn_count = 0;
+    scene_graph_render_view(graph, (Bounds){-1000, -1000, 3000, 3000});
+    assert_drawn_in_order(decals, 6);
+
+    // The radix sort keys static siblings the same way, switching a layer forces it to a full sort
+    scene_graph_layer_ysort_set(graph, 1, false);
+    scene_graph_layer_ysort_set(graph, 1, true);
+    scene_graph_ysort_parallel(graph, NULL);
+    drawn_count = 0;
+    scene_graph_render(graph);
+    assert_drawn_in_order(decals, 6);
+    TEST_ASSERT_TRUE(graph->draw_ranks[scene_graph_slot(decals[1])] <
+                     graph->draw_ranks[scene_graph_slot(decals[3])]);
+
+    scene_graph_free(graph);
+}
+
+typedef struct GraphFrame {
+    Position positions[1000];
+    int drawn[1000];
+    int drawn_count;
+} GraphFrame;
+
+static void capture_frame(SceneGraph* graph, const Node* nodes, int count, GraphFrame* frame) {
+    for (int i = 0; i < count; i++) {
+        frame->positions[i] = scene_graph_position_get(graph, nodes[i]);
+    }
+
+    drawn_count = 0;
+    scene_graph_render(graph);
+    memcpy(frame->drawn, drawn, sizeof(int) * drawn_count);
+    frame->drawn_count = drawn_count;
+}
+
+static void assert_frame(SceneGraph* graph, const Node* nodes, int count, const GraphFrame* frame) {
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(scene_graph_node_valid(graph, nodes[i]));
+        Position p = scene_graph_position_get(graph, nodes[i]);
+        TEST_ASSERT_EQUAL_FLOAT(frame->positions[i].x, p.x);
+        TEST_ASSERT_EQUAL_FLOAT(frame->positions[i].y, p.y);
+    }
+
+    drawn_count = 0;
+    scene_graph_render(graph);
+    TEST_ASSERT_EQUAL(frame->drawn_count, drawn_count);
+    TEST_ASSERT_EQUAL_INT_ARRAY(frame->drawn, drawn, drawn_count);
+}
+
+static void snapshot_restore_rewinds(void) {
+    const int count      = 400;
+    Node nodes[400]      = {0};
+    SceneGraph* graph    = scene_graph_new();
+    SceneSnapshot* full  = scene_snapshot_new();
+    SceneSnapshot* delta = scene_snapshot_new();
+    static GraphFrame first;
+    static GraphFrame second;
+
+    srand(17);
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        nodes[i] = scene_graph_node_new(graph, nodes[i < 100 ? 0 : rand() % i]);
+        scene_graph_local_position_set(graph, nodes[i], (Position){rand() % 300, rand() % 300});
+
+        Drawable* drawable = scene_graph_drawable_new(graph, nodes[i]);
+        drawable->draw     = record_draw;
+        scene_graph_drawable_bounds_set(graph, nodes[i], (Bounds){0, 0, 16, 16});
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    scene_graph_snapshot(graph, full, NULL);
+    capture_frame(graph, nodes, count, &first);
+
+    // A quiet frame only differs from the last one in a few blocks
+    for (int i = 0; i < 5; i++) {
+        scene_graph_local_position_set(graph, nodes[1 + rand() % (count - 1)], (Position){rand() % 300, rand() % 300});
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    scene_graph_snapshot(graph, delta, full);
+    capture_frame(graph, nodes, count, &second);
+    TEST_ASSERT_TRUE(delta->delta);
+    TEST_ASSERT_LESS_THAN(full->size / 4, (size_t)delta->blocks_count * SCENE_SNAPSHOT_BLOCK);
+
+    // Diverge: destroy, spawn past the capacity, reparent, rotate and change layers
+    int capacity = graph->capacity;
+    scene_graph_node_destroy(graph, nodes[3]);
+    scene_graph_node_destroy(graph, nodes[150]);
+    scene_graph_remove_destroyed_nodes(graph);
+
+    Node spawned[300];
+    for (int i = 0; i < 300; i++) {
+        spawned[i] = scene_graph_node_new(graph, nodes[0]);
+        scene_graph_drawable_new(graph, spawned[i]);
+        scene_graph_local_position_set(graph, spawned[i], (Position){rand() % 300, rand() % 300});
+    }
+
+    TEST_ASSERT_GREATER_THAN(capacity, graph->capacity);
+    if (scene_graph_node_valid(graph, nodes[300])) {
+        scene_graph_node_reparent(graph, nodes[300], spawned[0]);
+    }
+    scene_graph_rotation_set(graph, nodes[5], 1.0f);
+    scene_graph_layer_set(graph, nodes[6], 2);
+    scene_graph_local_position_set(graph, nodes[7], (Position){-50, -50});
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+
+    // Back to the quiet frame through the delta, then to the first frame
+    scene_graph_restore(graph, delta, full);
+    assert_frame(graph, nodes, count, &second);
+    TEST_ASSERT_FALSE(scene_graph_node_valid(graph, spawned[299]));
+    assert_parents_first(graph);
+
+    scene_graph_restore(graph, full, NULL);
+    assert_frame(graph, nodes, count, &first);
+    assert_ysorted(graph);
+
+    // Running on from the restored frame hands out the same handles every time
+    Node again = scene_graph_node_new(graph, nodes[0]);
+    scene_graph_restore(graph, full, NULL);
+    TEST_ASSERT_EQUAL(again, scene_graph_node_new(graph, nodes[0]));
+
+    for (int i = 0; i < 50; i++) {
+        scene_graph_local_position_set(graph, nodes[1 + rand() % (count - 1)], (Position){rand() % 300, rand() % 300});
+    }
+
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    assert_ysorted(graph);
+
+    int visible = 0;
+    for (int i = 0; i < graph->nodes_count; i++) {
+        visible += graph->drawable_indices[scene_graph_slot(graph->node_ids[i])] != NODE_NULL;
+    }
+    drawn_count = 0;
+    scene_graph_render_view(graph, (Bounds){-1000, -1000, 5000, 5000});
+    TEST_ASSERT_EQUAL(visible, drawn_count);
+
+    scene_snapshot_free(delta);
+    scene_snapshot_free(full);
+    scene_graph_free(graph);
+}
+
+static void draw_transform_interpolates_ticks(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node gone         = scene_graph_node_new(graph, root);
+    Node node         = scene_graph_node_new(graph, root);
+    Node child        = scene_graph_node_new(graph, node);
+
+    scene_graph_local_position_set(graph, node, (Position){10, 20});
+    scene_graph_local_position_set(graph, child, (Position){1, 1});
+    scene_graph_compute_positions(graph);
+
+    // One tick later the node moved, storage compacted and a new node arrived
+    scene_graph_tick_begin(graph);
+    scene_graph_local_position_set(graph, node, (Position){30, 60});
+    scene_graph_node_destroy(graph, gone);
+    scene_graph_remove_destroyed_nodes(graph);
+    Node spawned = scene_graph_node_new(graph, root);
+    scene_graph_local_position_set(graph, spawned, (Position){5, 5});
+    scene_graph_compute_positions(graph);
+
+    scene_graph_alpha_set(graph, 0.25f);
+    Transform2D t = scene_graph_draw_transform_get(graph, node);
+    TEST_ASSERT_EQUAL_FLOAT(15, t.tx);
+    TEST_ASSERT_EQUAL_FLOAT(30, t.ty);
+
+    t = scene_graph_draw_transform_get(graph, child);
+    TEST_ASSERT_EQUAL_FLOAT(16, t.tx);
+    TEST_ASSERT_EQUAL_FLOAT(31, t.ty);
+
+    // A node without a previous tick is drawn where it is
+    t = scene_graph_draw_transform_get(graph, spawned);
+    TEST_ASSERT_EQUAL_FLOAT(5, t.tx);
+    TEST_ASSERT_EQUAL_FLOAT(5, t.ty);
+
+    scene_graph_alpha_set(graph, 1.0f);
+    t = scene_graph_draw_transform_get(graph, node);
+    TEST_ASSERT_EQUAL_FLOAT(30, t.tx);
+    TEST_ASSERT_EQUAL_FLOAT(60, t.ty);
+
+    scene_graph_free(graph);
+}
+
+static int kind_updates[64];
+static int kind_batches;
+static int spawn_kind;
+static Node spawned_node;
+
+static void record_custom_update(SceneGraph* graph, GameObject* object) {
+    kind_updates[scene_graph_slot(object->node)]++;
+}
+
+static void record_kind_update(SceneGraph* graph, int first, int count) {
+    int kind = graph->game_objects[first].kind;
+    for (int i = first; i < first + count; i++) {
+        TEST_ASSERT_EQUAL(kind, graph->game_objects[i].kind);
+        kind_updates[scene_graph_slot(graph->game_objects[i].node)]++;
+    }
+
+    // Spawns one object of a kind that may already have run, it has to wait for the next pass
+    if (spawn_kind != SCENE_GRAPH_KIND_CUSTOM) {
+        spawned_node = scene_graph_node_new(graph, graph->node_ids[0]);
+        scene_graph_game_object_new_kind(graph, spawned_node, spawn_kind);
+        spawn_kind = SCENE_GRAPH_KIND_CUSTOM;
+    }
+
+    kind_batches++;
+}
+
+static int drawn_runs;
+
+// Captures the stamp the drawable's data holds at the time, batches only ever see this copy
+static void capture_stamp(const Drawable* drawable, DrawSource* source) {
+    const int* stamp = drawable->data;
+    source->texture  = stamp != NULL ? *stamp : scene_graph_slot(drawable->node);
+}
+
+static void record_draw_run(const Drawable* drawables,
+                            const DrawSource* sources,
+                            const Transform2D* transforms,
+                            int count) {
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(drawables[0].kind, drawables[i].kind);
+        if (drawables[i].data == NULL) {
+            TEST_ASSERT_EQUAL(scene_graph_slot(drawables[i].node), sources[i].texture);
+        }
+
+        record_draw(&drawables[i], &transforms[i]);
+    }
+
+    drawn_runs++;
+}
+
+static void assert_kinds_packed(SceneGraph* graph) {
+    const int* offsets = graph->game_object_offsets;
+    TEST_ASSERT_EQUAL(0, offsets[0]);
+    TEST_ASSERT_EQUAL(graph->game_objects_count, offsets[SCENE_GRAPH_KINDS]);
+
+    for (int kind = 0; kind < SCENE_GRAPH_KINDS; kind++) {
+        for (int i = offsets[kind]; i < offsets[kind + 1]; i++) {
+            TEST_ASSERT_EQUAL(kind, graph->game_objects[i].kind);
+            TEST_ASSERT_EQUAL(i, graph->game_object_indices[scene_graph_slot(graph->game_objects[i].node)]);
+        }
+    }
+}
+
+static void kinds_batch_updates_and_draws(void) {
+    SceneGraph* graph = scene_graph_new();
+    int walk          = scene_graph_update_kind_register(graph, record_kind_update);
+    int talk          = scene_graph_update_kind_register(graph, record_kind_update);
+    int sprite        = scene_graph_draw_kind_register(graph, record_draw_run, capture_stamp);
+    TEST_ASSERT_EQUAL(1, walk);
+    TEST_ASSERT_EQUAL(2, talk);
+    TEST_ASSERT_EQUAL(1, sprite);
+
+    Node root = scene_graph_node_new(graph, NODE_NULL);
+    Node nodes[30];
+    for (int i = 0; i < 30; i++) {
+        nodes[i]           = scene_graph_node_new(graph, root);
+        int kind           = i % 3 == 0 ? SCENE_GRAPH_KIND_CUSTOM : i % 3 == 1 ? talk : walk;
+        GameObject* object = scene_graph_game_object_new_kind(graph, nodes[i], kind);
+        object->update     = record_custom_update;
+
+        // Runs of four sprites between single custom drawables
+        Drawable* drawable = scene_graph_drawable_new_kind(graph, nodes[i], i % 5 == 0 ? 0 : sprite);
+        drawable->draw     = record_draw;
+        scene_graph_local_position_set(graph, nodes[i], (Position){0, i});
+    }
+
+    assert_kinds_packed(graph);
+
+    // Registered kinds ignore the update pointer and run once per kind
+    memset(kind_updates, 0, sizeof(kind_updates));
+    kind_batches = 0;
+    spawn_kind   = walk;
+    scene_graph_update(graph);
+    TEST_ASSERT_EQUAL(2, kind_batches);
+    for (int i = 0; i < 30; i++) {
+        TEST_ASSERT_EQUAL(1, kind_updates[scene_graph_slot(nodes[i])]);
+    }
+
+    TEST_ASSERT_EQUAL(0, kind_updates[scene_graph_slot(spawned_node)]);
+    assert_kinds_packed(graph);
+
+    for (int i = 0; i < 30; i += 4) {
+        scene_graph_node_destroy(graph, nodes[i]);
+    }
+
+    scene_graph_remove_destroyed_nodes(graph);
+    assert_kinds_packed(graph);
+
+    scene_graph_update(graph);
+    TEST_ASSERT_EQUAL(1, kind_updates[scene_graph_slot(spawned_node)]);
+
+    // Batches see their drawables in draw order, a run breaks at every custom drawable
+    scene_graph_compute_positions(graph);
+    scene_graph_ysort(graph);
+    drawn_count = 0;
+    drawn_runs  = 0;
+    scene_graph_render(graph);
+    TEST_ASSERT_EQUAL(graph->drawables_count, drawn_count);
+    for (int i = 0; i < drawn_count; i++) {
+        TEST_ASSERT_EQUAL(graph->render_list[i], scene_graph_slot(drawn[i]));
+    }
+
+    int runs = 0;
+    for (int i = 0; i < drawn_count; i++) {
+        const Drawable* drawable = &graph->drawables[graph->drawable_indices[scene_graph_slot(drawn[i])]];
+        const Drawable* previous =
+            i > 0 ? &graph->drawables[graph->drawable_indices[scene_graph_slot(drawn[i - 1])]] : NULL;
+        if (drawable->kind == sprite && (previous == NULL || previous->kind != sprite)) runs++;
+    }
+
+    TEST_ASSERT_EQUAL(runs, drawn_runs);
+    scene_graph_free(graph);
+}
+
+static int journal_changes(SceneGraph* graph, Node node) {
+    int changes = 0;
+    for (int i = 0; i < graph->journal_count; i++) {
+        if (graph->journal[i].node == node) {
+            TEST_ASSERT_EQUAL(0, changes);  // one entry per node and frame
+            changes = graph->journal[i].changes;
+        }
+    }
+
+    return changes;
+}
+
+static void journal_records_frame_changes(void) {
+    SceneGraph* graph = scene_graph_new();
+    Node root         = scene_graph_node_new(graph, NODE_NULL);
+    Node a            = scene_graph_node_new(graph, root);
+    Node b            = scene_graph_node_new(graph, root);
+    Node child        = scene_graph_node_new(graph, a);
+    Node still        = scene_graph_node_new(graph, root);
+    scene_graph_compute_positions(graph);
+
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_CREATED, journal_changes(graph, a));
+    TEST_ASSERT_EQUAL(5, graph->journal_count);
+    scene_graph_journal_clear(graph);
+
+    // Moves reach the children through the sweep, repeated writes merge into one entry
+    scene_graph_local_position_set(graph, a, (Position){10, 0});
+    scene_graph_compute_positions(graph);
+    scene_graph_local_position_set(graph, a, (Position){20, 0});
+    scene_graph_compute_positions(graph);
+    scene_graph_layer_set(graph, b, 3);
+    scene_graph_node_reparent(graph, b, a);
+    scene_graph_compute_positions(graph);
+
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_MOVED, journal_changes(graph, a));
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_MOVED, journal_changes(graph, child));
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_MOVED | SCENE_CHANGE_LAYER | SCENE_CHANGE_PARENT, journal_changes(graph, b));
+    TEST_ASSERT_EQUAL(0, journal_changes(graph, still));
+    TEST_ASSERT_EQUAL(3, graph->journal_count);
+    scene_graph_journal_clear(graph);
+
+    // The whole subtree is destroyed, a node reusing a slot gets an entry of its own
+    scene_graph_node_destroy(graph, a);
+    scene_graph_remove_destroyed_nodes(graph);
+    Node spawned = scene_graph_node_new(graph, root);
+    TEST_ASSERT_EQUAL(scene_graph_slot(child), scene_graph_slot(spawned));
+
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_DESTROYED, journal_changes(graph, a));
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_DESTROYED, journal_changes(graph, b));
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_DESTROYED, journal_changes(graph, child));
+    TEST_ASSERT_EQUAL(SCENE_CHANGE_CREATED, journal_changes(graph, spawned));
+    TEST_ASSERT_EQUAL(4, graph->journal_count);
+
+    scene_graph_free(graph);
+}
+
+typedef struct PresentRun {
+    SceneGraph* graph;
+    ScenePresent* present;
+    const Node* nodes;
+    int* stamps;
+    int count;
+    int frames;
+} PresentRun;
+
+// Every step moves all nodes into the band of y values that belongs to that step and stamps them
+// with it, the stamps change again while the render thread draws the published frame
+static void* present_simulate(void* arg) {
+    PresentRun* run = arg;
+
+    for (int f = 0; f < run->frames; f++) {
+        for (int i = 1; i < run->count; i++) {
+            scene_graph_local_position_set(run->graph, run->nodes[i], (Position){i, f * 1000 + rand() % 1000});
+            run->stamps[i] = f;
+        }
+
+        scene_graph_compute_positions(run->graph);
+        scene_graph_ysort(run->graph);
+        scene_present_publish(run->present, run->graph, (Bounds){0, f * 1000, 1000, 1000});
+    }
+
+    return NULL;
+}
+
+static void present_hands_frames_across_threads(void) {
+    const int count       = 200;
+    Node nodes[200]       = {0};
+    int stamps[200]       = {0};
+    SceneGraph* graph     = scene_graph_new();
+    ScenePresent* present = scene_present_new();
+    int stamped           = scene_graph_draw_kind_register(graph, record_draw_run, capture_stamp);
+
+    // Every other drawable batched from its captured stamp, the rest drawn one by one
+    nodes[0] = scene_graph_node_new(graph, NODE_NULL);
+    for (int i = 1; i < count; i++) {
+        nodes[i]           = scene_graph_node_new(graph, nodes[0]);
+        int kind           = i % 2 == 0 ? stamped : SCENE_GRAPH_KIND_CUSTOM;
+        Drawable* drawable = scene_graph_drawable_new_kind(graph, nodes[i], kind);
+        drawable->draw     = record_draw;
+        drawable->data     = &stamps[i];
+        scene_graph_drawable_bounds_set(graph, nodes[i], (Bounds){0, 0, 1, 1});
+    }
+
+    PresentRun run = {
+        .graph = graph, .present = present, .nodes = nodes, .stamps = stamps, .count = count};
+    run.frames     = 50;
+    pthread_t simulation;
+    pthread_create(&simulation, NULL, present_simulate, &run);
+
+    // No step is skipped and every frame only holds what its own step published, sorted by y
+    for (int f = 0; f < run.frames; f++) {
+        const PresentFrame* frame = scene_present_acquire(present);
+        TEST_ASSERT_NOT_NULL(frame);
+        TEST_ASSERT_EQUAL_FLOAT(f * 1000, frame->view.y);
+        TEST_ASSERT_EQUAL(count - 1, frame->count);
+
+        for (int i = 0; i < frame->count; i++) {
+            TEST_ASSERT_FLOAT_WITHIN(500, f * 1000 + 500, frame->transforms[i].ty);
+            if (i > 0) {
+                TEST_ASSERT_TRUE(frame->transforms[i - 1].ty <= frame->transforms[i].ty);
+            }
+
+            if (frame->drawables[i].kind == stamped) {
+                TEST_ASSERT_EQUAL(f, frame->sources[i].texture);
+            }
+        }
+
+        drawn_count = 0;
+        scene_present_draw(frame);
+        TEST_ASSERT_EQUAL(frame->count, drawn_count);
+        scene_present_release(present);
+    }
+
+    pthread_join(simulation, NULL);
+
+    // Closing wakes a render thread waiting for a step that never comes
+    scene_present_close(present);
+    TEST_ASSERT_NULL(scene_present_acquire(present));
+
+    scene_present_free(present);
+    scene_graph_free(graph);
 }
 
 int main(void) {
@@ -263,11 +1732,36 @@ int main(void) {
     RUN_TEST(simple_insert);
     RUN_TEST(simple_move);
     RUN_TEST(move_parent_and_child_local);
+    RUN_TEST(coalesce_repeated_updates);
     RUN_TEST(graph_sorting);
     RUN_TEST(graph_check_stable_sort);
     RUN_TEST(delete_node_from_graph);
     RUN_TEST(delete_node_with_game_object);
     RUN_TEST(delete_node_with_drawable);
+    RUN_TEST(delete_subtree_keeps_parents_first);
+    RUN_TEST(world_writes_resolve_deep_chains);
+    RUN_TEST(reparent_moves_subtree);
+    RUN_TEST(reparents_relayout_once);
+    RUN_TEST(destroy_squad_unlinks_from_parent);
+    RUN_TEST(stale_handle_does_not_alias);
+    RUN_TEST(command_buffers_apply_in_order);
+    RUN_TEST(command_buffers_drop_missing_parents);
+    RUN_TEST(transform_kernel_matches_scalar);
+    RUN_TEST(rotated_parent_carries_child);
+    RUN_TEST(translation_only_after_reset);
+    RUN_TEST(parallel_matches_serial);
+    RUN_TEST(grow_past_initial_capacity);
+    RUN_TEST(render_view_culls_offscreen);
+    RUN_TEST(incremental_ysort_repairs_movers);
     RUN_TEST(test_order_of_sorting);
+    RUN_TEST(radix_ysort_matches_serial);
+    RUN_TEST(render_follows_draw_order);
+    RUN_TEST(render_layers_bucket_drawables);
+    RUN_TEST(static_layers_keep_creation_order);
+    RUN_TEST(snapshot_restore_rewinds);
+    RUN_TEST(present_hands_frames_across_threads);
+    RUN_TEST(draw_transform_interpolates_ticks);
+    RUN_TEST(kinds_batch_updates_and_draws);
+    RUN_TEST(journal_records_frame_changes);
     return UNITY_END();
 }
@@ -0,0 +1,304 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "thread-pool/parallel.h"
+#include "thread-pool/task-graph.h"
+#include "thread-pool/thread-pool.h"
+
+#define JOBS 200000
+
+void setUp() {
+}
+void tearDown() {
+}
+
+static atomic_int hits[JOBS];
+static ThreadPool* split_pool;
+
+typedef struct Range {
+    int first;
+    int count;
+    JobCounter* counter;
+} Range;
+
+static void range_run(ThreadPool* pool, int first, int count, JobCounter* counter);
+
+// Splits down to single jobs so most of them are pushed by workers and stolen by others
+static void range_split(void* argument) {
+    Range* range = argument;
+    if (range->count == 1) {
+        atomic_fetch_add(&hits[range->first], 1);
+    } else {
+        int half = range->count / 2;
+        range_run(split_pool, range->first, half, range->counter);
+        range_run(split_pool, range->first + half, range->count - half, range->counter);
+    }
+
+    free(range);
+}
+
+static void range_run(ThreadPool* pool, int first, int count, JobCounter* counter) {
+    Range* range = malloc(sizeof(Range));
+    *range       = (Range){first, count, counter};
+    thread_pool_run(pool, range_split, range, counter);
+}
+
+static void assert_hit_once(int count) {
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(1, atomic_load(&hits[i]));
+        atomic_store(&hits[i], 0);
+    }
+}
+
+static void every_job_runs_once(void) {
+    split_pool         = thread_pool_create(8);
+    JobCounter counter = {0};
+
+    // Roots go through the shared queue, everything below them through the worker deques
+    for (int i = 0; i < 64; i++) {
+        range_run(split_pool, i * (JOBS / 64), JOBS / 64, &counter);
+    }
+
+    thread_pool_wait(split_pool, &counter);
+    TEST_ASSERT_EQUAL(0, atomic_load(&counter.pending));
+    assert_hit_once(JOBS / 64 * 64);
+
+    thread_pool_destroy(split_pool);
+}
+
+typedef struct Sum {
+    int first;
+    int count;
+    long result;
+} Sum;
+
+// Fork and join inside a job, the waiting worker keeps running jobs while its children finish
+static void sum_job(void* argument) {
+    Sum* sum = argument;
+    if (sum->count <= 64) {
+        for (int i = sum->first; i < sum->first + sum->count; i++) {
+            sum->result += i;
+        }
+        return;
+    }
+
+    int half           = sum->count / 2;
+    Sum left           = {sum->first, half, 0};
+    Sum right          = {sum->first + half, sum->count - half, 0};
+    JobCounter counter = {0};
+    thread_pool_run(split_pool, sum_job, &left, &counter);
+    thread_pool_run(split_pool, sum_job, &right, &counter);
+    thread_pool_wait(split_pool, &counter);
+    sum->result = left.result + right.result;
+}
+
+static void nested_waits_join(void) {
+    split_pool         = thread_pool_create(4);
+    Sum sum            = {0, JOBS, 0};
+    JobCounter counter = {0};
+
+    thread_pool_run(split_pool, sum_job, &sum, &counter);
+    thread_pool_wait(split_pool, &counter);
+    TEST_ASSERT_EQUAL((long)JOBS * (JOBS - 1) / 2, sum.result);
+
+    thread_pool_destroy(split_pool);
+}
+
+static void pool_without_workers_runs_on_wait(void) {
+    split_pool         = thread_pool_create(0);
+    JobCounter counter = {0};
+
+    range_run(split_pool, 0, 1000, &counter);
+    TEST_ASSERT_EQUAL(0, atomic_load(&hits[0]));
+    thread_pool_wait(split_pool, &counter);
+    assert_hit_once(1000);
+
+    thread_pool_destroy(split_pool);
+}
+
+static void hit_job(void* argument) {
+    atomic_fetch_add((atomic_int*)argument, 1);
+}
+
+// Small batches with idle gaps, workers park and wake between every one of them
+static void batches_wake_parked_workers(void) {
+    split_pool = thread_pool_create(8);
+
+    for (int round = 0; round < 2000; round++) {
+        JobCounter counter = {0};
+        for (int i = 0; i < 16; i++) {
+            thread_pool_run(split_pool, hit_job, &hits[i], &counter);
+        }
+
+        thread_pool_wait(split_pool, &counter);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        TEST_ASSERT_EQUAL(2000, atomic_load(&hits[i]));
+        atomic_store(&hits[i], 0);
+    }
+
+    thread_pool_destroy(split_pool);
+}
+
+static void hit_range(void* context, int chunk, int begin, int end) {
+    int* chunks = context;
+    for (int i = begin; i < end; i++) {
+        atomic_fetch_add(&hits[i], 1);
+    }
+
+    chunks[chunk] = end - begin;
+}
+
+static void sum_range(void* context, int begin, int end, void* partial) {
+    for (int i = begin; i < end; i++) {
+        *(long*)partial += i;
+    }
+}
+
+static void sum_combine(void* context, void* result, const void* partial) {
+    *(long*)result += *(const long*)partial;
+}
+
+static void nested_range(void* context, int chunk, int begin, int end) {
+    int chunks[PARALLEL_MAX_CHUNKS];
+    for (int block = begin; block < end; block++) {
+        parallel_for(context, block * (JOBS / 8), (block + 1) * (JOBS / 8), 100, hit_range, chunks);
+    }
+}
+
+static void parallel_loops_cover_range(void) {
+    ThreadPool* pool = thread_pool_create(4);
+
+    // One chunk per worker and the caller, none of them under the grain
+    TEST_ASSERT_EQUAL(5, parallel_chunks(pool, JOBS, 100));
+    TEST_ASSERT_EQUAL(3, parallel_chunks(pool, 350, 100));
+    TEST_ASSERT_EQUAL(1, parallel_chunks(pool, 100, 100));
+    TEST_ASSERT_EQUAL(1, parallel_chunks(NULL, JOBS, 1));
+
+    int chunks[PARALLEL_MAX_CHUNKS] = {0};
+    parallel_for(pool, 10, JOBS, 100, hit_range, chunks);
+    TEST_ASSERT_EQUAL(0, atomic_load(&hits[9]));
+    for (int i = 10; i < JOBS; i++) {
+        TEST_ASSERT_EQUAL(1, atomic_load(&hits[i]));
+        atomic_store(&hits[i], 0);
+    }
+
+    int covered = 0;
+    for (int c = 0; c < 5; c++) {
+        TEST_ASSERT_GREATER_OR_EQUAL(100, chunks[c]);
+        covered += chunks[c];
+    }
+    TEST_ASSERT_EQUAL(JOBS - 10, covered);
+
+    long sum = 0;
+    parallel_reduce(pool, 0, JOBS, 100, &sum, sizeof(sum), sum_range, sum_combine, NULL);
+    TEST_ASSERT_EQUAL((long)JOBS * (JOBS - 1) / 2, sum);
+
+    // Loops nest, a chunk waiting on its own loop keeps running the pool's jobs
+    parallel_for(pool, 0, 8, 1, nested_range, pool);
+    assert_hit_once(JOBS);
+
+    thread_pool_destroy(pool);
+}
+
+static void* pin_self(void* argument) {
+    *(bool*)argument = thread_pool_pin_reserved(pthread_self(), 0);
+    return NULL;
+}
+
+static void pinned_workers_run_jobs(void) {
+    const int cpus  = thread_pool_cpu_count();
+    const int cores = thread_pool_core_count();
+    TEST_ASSERT_GREATER_OR_EQUAL(1, cpus);
+    TEST_ASSERT_TRUE(cores >= 1 && cores <= cpus);
+
+    // A thread outside the pool takes a reserved core, the first one always exists
+    bool reserved = false;
+    pthread_t thread;
+    pthread_create(&thread, NULL, pin_self, &reserved);
+    pthread_join(thread, NULL);
+#if defined(__linux__)
+    TEST_ASSERT_TRUE(reserved);
+#endif
+
+    // More workers than CPUs, the ones past the last CPU stay unpinned
+    split_pool = thread_pool_create(cpus + 2);
+    int pinned = thread_pool_pin(split_pool, 1);
+    TEST_ASSERT_TRUE(pinned >= 0 && pinned <= cpus - 1);
+
+    JobCounter counter = {0};
+    range_run(split_pool, 0, 1000, &counter);
+    thread_pool_wait(split_pool, &counter);
+    assert_hit_once(1000);
+
+    thread_pool_destroy(split_pool);
+}
+
+static atomic_int finished;
+static int finish_order[6];
+
+static void record_finish(void* argument) {
+    finish_order[(int)(size_t)argument] = atomic_fetch_add(&finished, 1);
+}
+
+static void task_graph_orders_conflicts(void) {
+    ThreadPool* pool = thread_pool_create(4);
+    TaskGraph* graph = task_graph_new(pool);
+    int a, b;
+
+    // Two readers between two writers of a, a writer of b on its own and a task reading both
+    const char* names[6] = {
+        "write_a", "read_a", "read_a_again", "write_a_again", "write_b", "read_both"};
+    int tasks[6];
+    for (int i = 0; i < 6; i++) {
+        tasks[i] = task_graph_add(graph, names[i], record_finish, (void*)(size_t)i);
+    }
+
+    task_graph_write(graph, tasks[0], &a);
+    task_graph_read(graph, tasks[1], &a);
+    task_graph_read(graph, tasks[2], &a);
+    task_graph_write(graph, tasks[3], &a);
+    task_graph_write(graph, tasks[4], &b);
+    task_graph_read(graph, tasks[5], &a);
+    task_graph_read(graph, tasks[5], &b);
+
+    for (int run = 0; run < 500; run++) {
+        atomic_store(&finished, 0);
+        task_graph_run(graph);
+
+        TEST_ASSERT_EQUAL(6, atomic_load(&finished));
+        TEST_ASSERT_TRUE(finish_order[0] < finish_order[1] && finish_order[0] < finish_order[2]);
+        TEST_ASSERT_TRUE(finish_order[1] < finish_order[3] && finish_order[2] < finish_order[3]);
+        TEST_ASSERT_TRUE(finish_order[3] < finish_order[5] && finish_order[4] < finish_order[5]);
+    }
+
+    char dump[1024] = {0};
+    FILE* out       = tmpfile();
+    task_graph_dump(graph, out);
+    rewind(out);
+    fread(dump, 1, sizeof(dump) - 1, out);
+    fclose(out);
+
+    TEST_ASSERT_NOT_NULL(strstr(dump, "task graph: 6 tasks in 4 levels\n"));
+    TEST_ASSERT_NOT_NULL(strstr(dump, "level 0:\n  write_a\n  write_b\n"));
+    TEST_ASSERT_NOT_NULL(strstr(dump, "  write_a_again <- write_a, read_a, read_a_again\n"));
+    TEST_ASSERT_NOT_NULL(strstr(dump, "level 3:\n  read_both <- write_a_again, write_b\n"));
+
+    task_graph_free(graph);
+    thread_pool_destroy(pool);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(every_job_runs_once);
+    RUN_TEST(nested_waits_join);
+    RUN_TEST(pool_without_workers_runs_on_wait);
+    RUN_TEST(batches_wake_parked_workers);
+    RUN_TEST(pinned_workers_run_jobs);
+    RUN_TEST(parallel_loops_cover_range);
+    RUN_TEST(task_graph_orders_conflicts);
+    return UNITY_END();
+}